@@ -7,16 +7,23 @@
 #include <unistd.h>
 #include <strings.h>
 #include <sys/socket.h>
+#include "MemPool.h"
+
+// 每个线程一块临时内存, 读取套接字数据时放缓冲区放不下的部分, 不再每次读取都 malloc/free
+static __thread char* readScratch = NULL;
 
 struct Buffer* bufferInit(int size)
 {
-    struct Buffer* buffer = (struct Buffer*)malloc(sizeof(struct Buffer));
+    // 结构体和数据块都从当前线程的内存池中分配, 数据块的大小向上取整到内存池的等级, 多出来的部分也可以使用
+    // 缓冲区中的数据都通过 readPos/writePos 和长度访问, 不需要清零
+    struct Buffer* buffer = (struct Buffer*)memPoolAlloc(sizeof(struct Buffer));
     if (buffer != NULL)
     {
-        buffer->data = (char*)malloc(size);
-        buffer->capacity = size;
+        buffer->capacity = (int)memPoolRoundUp(size);
+        buffer->data = (char*)memPoolAlloc(buffer->capacity);
         buffer->writePos = buffer->readPos = 0;
-        memset(buffer->data, 0, size);
+        buffer->pinned = 0;
+        buffer->readHint = ReadHintMin;
     }
     return buffer;
 }
@@ -25,12 +32,9 @@ void bufferDestroy(struct Buffer* buf)
 {
     if (buf != NULL)
     {
-        if (buf->data != NULL)
-        {
-            free(buf->data);
-        }
+        memPoolFree(buf->data, buf->capacity);
+        memPoolFree(buf, sizeof(struct Buffer));
     }
-    free(buf);
 }
 
 void bufferExtendRoom(struct Buffer* buffer, int size)
@@ -41,13 +45,13 @@ void bufferExtendRoom(struct Buffer* buffer, int size)
         return;
     }
     // 2. 内存需要合并才够用 - 不需要扩容
-    // 剩余的可写的内存 + 已读的内存 > size
-    else if (buffer->readPos + bufferWriteableSize(buffer) >= size)
+    // 剩余的可写的内存 + 已读的内存 > size, 数据被固定的时候不能移动, 只能扩容
+    else if (buffer->pinned == 0 && buffer->readPos + bufferWriteableSize(buffer) >= size)
     {
         // 得到未读的内存大小
         int readable = bufferReadableSize(buffer);
         // 移动内存
-        memcpy(buffer->data, buffer->data + buffer->readPos, readable);
+        memmove(buffer->data, buffer->data + buffer->readPos, readable); // 内存区域可能重叠
         // 更新位置
         buffer->readPos = 0;
         buffer->writePos = readable;
@@ -55,15 +59,15 @@ void bufferExtendRoom(struct Buffer* buffer, int size)
     // 3. 内存不够用 - 扩容
     else
     {
-        void* temp = realloc(buffer->data, buffer->capacity + size);
+        int capacity = (int)memPoolRoundUp(buffer->capacity + size);
+        void* temp = memPoolRealloc(buffer->data, buffer->capacity, capacity);
         if (temp == NULL)
         {
             return; // 失败了
         }
-        memset(temp + buffer->capacity, 0, size);
         // 更新数据
         buffer->data = temp;
-        buffer->capacity += size;
+        buffer->capacity = capacity;
     }
 }
 
@@ -98,17 +102,29 @@ int bufferAppendString(struct Buffer* buffer, const char* data)
     return ret;
 }
 
+// 调整下一次预留的空间: 放不下时马上增大, 否则慢慢向最近读到的数据量靠拢
+static void bufferUpdateReadHint(struct Buffer* buffer, int result, int writeable)
+{
+    int hint = result > writeable ? result : (buffer->readHint * 3 + result) / 4;
+    buffer->readHint = hint < ReadHintMin ? ReadHintMin : (hint > ReadHintMax ? ReadHintMax : hint);
+}
+
 int bufferSocketRead(struct Buffer* buffer, int fd)
 {
+    // 按照这个连接最近每次读到的数据量预留空间, 通常一次 readv 就直接读到缓冲区中
+    bufferExtendRoom(buffer, buffer->readHint);
+    if (readScratch == NULL)
+    {
+        readScratch = (char*)malloc(ReadScratchSize);
+    }
     // read/recv/readv
     struct iovec vec[2];
     // 初始化数组元素
     int writeable = bufferWriteableSize(buffer);
     vec[0].iov_base = buffer->data + buffer->writePos;
     vec[0].iov_len = writeable;
-    char* tmpbuf = (char*)malloc(40960);
-    vec[1].iov_base = tmpbuf;
-    vec[1].iov_len = 40960;
+    vec[1].iov_base = readScratch;
+    vec[1].iov_len = readScratch != NULL ? ReadScratchSize : 0;
     int result = readv(fd, vec, 2);
     if (result == -1)
     {
@@ -121,12 +137,26 @@ int bufferSocketRead(struct Buffer* buffer, int fd)
     else
     {
         buffer->writePos = buffer->capacity;
-        bufferAppendData(buffer, tmpbuf, result - writeable);
+        bufferAppendData(buffer, readScratch, result - writeable);
     }
-    free(tmpbuf);
+    bufferUpdateReadHint(buffer, result, writeable);
     return result;
 }
 
+char* bufferPrepareRead(struct Buffer* buffer, int* size)
+{
+    bufferExtendRoom(buffer, buffer->readHint);
+    *size = bufferWriteableSize(buffer);
+    return buffer->data + buffer->writePos;
+}
+
+void bufferCommitRead(struct Buffer* buffer, int result, int size)
+{
+    buffer->writePos += result;
+    // 没有临时内存, 填满了说明套接字中可能还有数据, 按照两倍的空间调整
+    bufferUpdateReadHint(buffer, result < size ? result : size * 2, size);
+}
+
 char* bufferFindCRLF(struct Buffer* buffer)
 {
     // strstr --> 大字符串中匹配子字符串(遇到\0结束) char *strstr(const char *haystack, const char *needle);
@@ -137,6 +167,21 @@ char* bufferFindCRLF(struct Buffer* buffer)
     return ptr;
 }
 
+void bufferPin(struct Buffer* buffer)
+{
+    buffer->pinned++;
+}
+
+void bufferUnpin(struct Buffer* buffer)
+{
+    buffer->pinned--;
+}
+
+char* bufferSliceData(struct Buffer* buffer, struct BufferSlice* slice)
+{
+    return buffer->data + slice->offset;
+}
+
 int bufferSendData(struct Buffer* buffer, int socket)
 {
     // 判断有无数据
@@ -147,7 +192,6 @@ int bufferSendData(struct Buffer* buffer, int socket)
         if (count > 0)
         {
             buffer->readPos += count;
-            usleep(1);
         }
         return count;
     }
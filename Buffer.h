@@ -1,5 +1,11 @@
 #pragma once
 
+// 读取套接字数据时缓冲区放不下的部分先读到线程的临时内存中, 再追加到缓冲区
+#define ReadScratchSize 65536
+// 每次读取之前缓冲区至少预留的空间, 以及根据连接的请求大小自动调整的上限
+#define ReadHintMin 1024
+#define ReadHintMax 65536
+
 struct Buffer
 {
     // 指向内存的指针
@@ -7,6 +13,15 @@ struct Buffer
     int capacity; // 总字节数
     int readPos;
     int writePos;
+    int pinned; // 大于 0 时不允许移动已有的数据(不合并内存), 保证 BufferSlice 的偏移量有效
+    int readHint; // 最近每次从套接字读到的数据量(指数加权平均), 读取之前预留这么多空间, 数据直接读到缓冲区中
+};
+
+// 缓冲区中的一段数据, 使用相对于 data 的偏移量, 扩容(realloc)之后仍然有效
+struct BufferSlice
+{
+    int offset;
+    int length;
 };
 
 // 初始化
@@ -24,7 +39,16 @@ int bufferAppendData(struct Buffer *buffer, const char *data, int size);
 int bufferAppendString(struct Buffer *buffer, const char *data);
 // 接收套接字数据
 int bufferSocketRead(struct Buffer *buffer, int fd);
+// 完成模式: 按照 readHint 预留空间, 返回接收数据的地址和大小(size), 数据由内核写入,
+// 完成之前不能再写入缓冲区; 完成之后调用 bufferCommitRead 提交实际接收的字节数
+char *bufferPrepareRead(struct Buffer *buffer, int *size);
+void bufferCommitRead(struct Buffer *buffer, int result, int size);
 // 根据\r\n取出一行, 找到其在数据块中的位置, 返回该位置
 char *bufferFindCRLF(struct Buffer *buffer);
+// 固定/解除固定缓冲区中的数据, 固定期间扩容时不会把未读的数据移动到内存的开始位置
+void bufferPin(struct Buffer *buffer);
+void bufferUnpin(struct Buffer *buffer);
+// 得到切片的起始地址, 缓冲区再次写入数据之后可能失效, 需要重新获取
+char *bufferSliceData(struct Buffer *buffer, struct BufferSlice *slice);
 // 发送数据
 int bufferSendData(struct Buffer *buffer, int socket);
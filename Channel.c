@@ -1,16 +1,18 @@
 #include "Channel.h"
 #include <stdlib.h>
+#include "MemPool.h"
 
 struct Channel* channelInit(int fd, int events, handleFunc readFunc, 
     handleFunc writeFunc, handleFunc destroyFunc, void* arg)
 {
-    struct Channel* channel = (struct Channel*)malloc(sizeof(struct Channel));
+    struct Channel* channel = (struct Channel*)memPoolAlloc(sizeof(struct Channel));
     channel->arg = arg;
     channel->fd = fd;
     channel->events = events;
     channel->readCallback = readFunc;
     channel->writeCallback = writeFunc;
     channel->destroyCallback = destroyFunc;
+    channel->result = 0;
     return channel;
 }
 
@@ -26,6 +28,18 @@ void writeEventEnable(struct Channel* channel, bool flag)
     }
 }
 
+void readEventEnable(struct Channel* channel, bool flag)
+{
+    if (flag)
+    {
+        channel->events |= ReadEvent;
+    }
+    else
+    {
+        channel->events = channel->events & ~ReadEvent;
+    }
+}
+
 bool isWriteEventEnable(struct Channel* channel)
 {
     return channel->events & WriteEvent;
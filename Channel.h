@@ -10,7 +10,9 @@ enum FDEvent
 {
     TimeOut = 0x01,   // 超时事件，值为 0x01
     ReadEvent = 0x02, // 读事件，值为 0x02
-    WriteEvent = 0x04 // 写事件，值为 0x04
+    WriteEvent = 0x04, // 写事件，值为 0x04
+    EdgeTrigger = 0x08, // 边沿触发，值为 0x08，读写回调需要一直处理到 EAGAIN
+    Completion = 0x10   // 完成模式，值为 0x10，接收/发送/accept 由内核完成之后才调用读写回调，结果保存在 result 中
 };
 
 // 定义 Channel 结构体，用于管理文件描述符及其相关事件和回调函数
@@ -22,6 +24,7 @@ struct Channel
     handleFunc writeCallback;   // 写事件的回调函数
     handleFunc destroyCallback; // 销毁事件的回调函数
     void *arg;                  // 回调函数的参数
+    int result;                 // 完成模式下刚刚完成的操作的结果：字节数、新连接的 fd 或者 -errno
 };
 
 // 初始化一个 Channel 结构体
@@ -40,6 +43,12 @@ void writeEventEnable(struct Channel *channel, bool flag);
 // - channel: 指向 Channel 结构体的指针
 // - flag: 布尔值，true 表示开启写事件检测，false 表示关闭写事件检测
 
+// 修改文件描述符fd的读事件（开启或关闭读事件检测）
+void readEventEnable(struct Channel *channel, bool flag);
+// 参数：
+// - channel: 指向 Channel 结构体的指针
+// - flag: 布尔值，true 表示开启读事件检测，false 表示关闭读事件检测
+
 // 判断是否需要检测文件描述符的写事件
 bool isWriteEventEnable(struct Channel *channel);
 // 参数：
@@ -2,6 +2,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "Channel.h"
+#include "MemPool.h"
 /*
 这个文件是做一个映射
 */
@@ -11,7 +13,7 @@ struct ChannelMap *channelMapInit(int size)
 {
     struct ChannelMap *map = (struct ChannelMap *)malloc(sizeof(struct ChannelMap));
     map->size = size;
-    map->list = (struct Channel **)malloc(size * sizeof(struct Channel *));
+    map->list = (struct Channel **)calloc(size, sizeof(struct Channel *));
     return map;
 }
 // 清空map
@@ -23,7 +25,7 @@ void ChannelMapClear(struct ChannelMap *map)
         {
             if (map->list[i] != NULL)
             {
-                free(map->list[i]);
+                memPoolFree(map->list[i], sizeof(struct Channel));
             }
         }
         free(map->list);
@@ -37,8 +39,8 @@ bool makeMapRoom(struct ChannelMap *map, int newSize, int unitSize)
     if (map->size < newSize)
     {
         int curSize = map->size;
-        // 容量每次扩大原来的一倍
-        while (curSize < newSize)
+        // 容量每次扩大原来的一倍, 要能存储下标为 newSize 的元素
+        while (curSize <= newSize)
         {
             curSize *= 2;
         }
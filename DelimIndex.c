@@ -0,0 +1,227 @@
+#include "DelimIndex.h"
+#include <stdlib.h>
+#include "MemPool.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DELIM_SIMD 1
+#endif
+
+// 扫描函数: 把 data 中 [from, to) 里所有分隔符的偏移量写到 out 中, 返回分隔符的个数
+typedef int (*scanFunc)(const char *data, int from, int to, int *out);
+
+static inline bool isDelim(char c)
+{
+    return c == '\r' || c == '\n' || c == ' ' || c == ':';
+}
+
+// 逐字节扫描, 也用来处理 SIMD 扫描剩下的不足一个向量的数据
+static int scanScalar(const char *data, int from, int to, int *out)
+{
+    int num = 0;
+    for (int i = from; i < to; ++i)
+    {
+        if (isDelim(data[i]))
+        {
+            out[num++] = i;
+        }
+    }
+    return num;
+}
+
+#ifdef DELIM_SIMD
+// SSE2: 一次比较 16 个字节, 得到的掩码中每一位对应一个字节
+static int scanSse2(const char *data, int from, int to, int *out)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i colon = _mm_set1_epi8(':');
+    int num = 0;
+    int i = from;
+    for (; i + 16 <= to; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, colon)));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(m);
+        while (mask != 0)
+        {
+            out[num++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    return num + scanScalar(data, i, to, out + num);
+}
+
+// AVX2: 一次比较 32 个字节, 运行时检测到 CPU 支持才会使用
+__attribute__((target("avx2"))) static int scanAvx2(const char *data, int from, int to, int *out)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i colon = _mm256_set1_epi8(':');
+    int num = 0;
+    int i = from;
+    for (; i + 32 <= to; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf)),
+                                    _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, colon)));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(m);
+        while (mask != 0)
+        {
+            out[num++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    return num + scanSse2(data, i, to, out + num);
+}
+#endif
+
+// 根据 CPU 支持的指令集选择扫描函数, 只在第一次使用的时候检测一次
+static scanFunc getScanFunc()
+{
+    static scanFunc func = NULL;
+    scanFunc f = __atomic_load_n(&func, __ATOMIC_RELAXED);
+    if (f == NULL)
+    {
+#ifdef DELIM_SIMD
+        __builtin_cpu_init();
+        f = __builtin_cpu_supports("avx2") ? scanAvx2 : scanSse2;
+#else
+        f = scanScalar;
+#endif
+        __atomic_store_n(&func, f, __ATOMIC_RELAXED);
+    }
+    return f;
+}
+
+void delimIndexInit(struct DelimIndex *index)
+{
+    index->pos = NULL;
+    index->capacity = 0;
+    delimIndexReset(index);
+}
+
+void delimIndexDestroy(struct DelimIndex *index)
+{
+    memPoolFree(index->pos, index->capacity * sizeof(int));
+    index->pos = NULL;
+    index->capacity = 0;
+}
+
+void delimIndexReset(struct DelimIndex *index)
+{
+    index->num = 0;
+    index->next = 0;
+    index->scanPos = -1;
+}
+
+void delimIndexRebase(struct DelimIndex *index, int from, int shift)
+{
+    int first = 0;
+    while (first < index->num && index->pos[first] < from)
+    {
+        first++;
+    }
+    index->num -= first;
+    for (int i = 0; i < index->num; ++i)
+    {
+        index->pos[i] = index->pos[first + i] - shift;
+    }
+    index->next = 0;
+    if (index->scanPos != -1)
+    {
+        index->scanPos -= shift;
+    }
+}
+
+void delimIndexShrink(struct DelimIndex *index)
+{
+    if (index->capacity <= DelimIndexInitSize)
+    {
+        return;
+    }
+    if (index->num == 0)
+    {
+        delimIndexDestroy(index);
+        return;
+    }
+    int capacity = DelimIndexInitSize;
+    while (capacity < index->num)
+    {
+        capacity *= 2;
+    }
+    if (capacity == index->capacity)
+    {
+        return;
+    }
+    int *temp = (int *)memPoolRealloc(index->pos, index->capacity * sizeof(int), capacity * sizeof(int));
+    if (temp != NULL)
+    {
+        index->pos = temp;
+        index->capacity = capacity;
+    }
+}
+
+void delimIndexScan(struct DelimIndex *index, const char *data, int from, int to)
+{
+    if (index->scanPos == -1)
+    {
+        index->scanPos = from;
+    }
+    if (index->scanPos >= to)
+    {
+        return;
+    }
+    // 最坏的情况每个字节都是分隔符
+    int need = index->num + (to - index->scanPos);
+    if (need > index->capacity)
+    {
+        int capacity = index->capacity == 0 ? DelimIndexInitSize : index->capacity;
+        while (capacity < need)
+        {
+            capacity *= 2;
+        }
+        int *temp = (int *)memPoolRealloc(index->pos, index->capacity * sizeof(int), capacity * sizeof(int));
+        if (temp == NULL)
+        {
+            return; // 失败了, 下一次再扫描
+        }
+        index->pos = temp;
+        index->capacity = capacity;
+    }
+    index->num += getScanFunc()(data, index->scanPos, to, index->pos + index->num);
+    index->scanPos = to;
+}
+
+int delimIndexFind(struct DelimIndex *index, const char *data, int from, int to, char ch)
+{
+    for (int i = index->next; i < index->num && index->pos[i] < to; ++i)
+    {
+        int pos = index->pos[i];
+        if (pos >= from && data[pos] == ch)
+        {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+int delimIndexFindCRLF(struct DelimIndex *index, const char *data, int from, int to)
+{
+    // 跳过已经解析过的分隔符
+    while (index->next < index->num && index->pos[index->next] < from)
+    {
+        index->next++;
+    }
+    for (int i = index->next; i < index->num && index->pos[i] + 1 < to; ++i)
+    {
+        int pos = index->pos[i];
+        if (data[pos] == '\r' && data[pos + 1] == '\n')
+        {
+            return pos;
+        }
+    }
+    return -1;
+}
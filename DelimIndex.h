@@ -0,0 +1,36 @@
+#pragma once
+#include <stdbool.h>
+
+// 分隔符索引: 对读缓冲区中的数据只扫描一遍, 记录所有 '\r', '\n', ' ', ':' 的位置,
+// 解析请求行和请求头的时候直接查索引, 不再对同一段数据反复调用 memmem
+// 扫描使用 SIMD 指令(AVX2 / SSE2), 其他平台使用逐字节扫描
+#define DelimIndexInitSize 256 // pos 数组的初始容量, 请求解析完之后超过这个容量的内存会被释放
+
+struct DelimIndex
+{
+    int *pos;     // 分隔符在缓冲区中的偏移量, 从小到大排列
+    int num;      // 分隔符的个数
+    int capacity; // pos 数组的容量
+    int next;     // 下一次查找的起始下标, 前面的分隔符都已经解析过了
+    int scanPos;  // 已经扫描到的位置, -1 表示还没有开始扫描
+};
+
+// 初始化
+void delimIndexInit(struct DelimIndex *index);
+// 释放内存
+void delimIndexDestroy(struct DelimIndex *index);
+// 清空索引, 下一次扫描从头开始
+void delimIndexReset(struct DelimIndex *index);
+// 丢掉 from 之前的分隔符(已经解析完的请求), 剩下的偏移量都减去 shift(缓冲区整理内存时数据向前移动的字节数),
+// 已经扫描过的数据不需要重新扫描
+void delimIndexRebase(struct DelimIndex *index, int from, int shift);
+// 缩小 pos 数组: 一个很大的请求(比如大量的空格)会让数组增长到缓冲区大小的好几倍,
+// 请求解析完之后缩回初始容量(剩下的分隔符比较多时缩到刚好放得下), 空闲的长连接不再占用这些内存
+void delimIndexShrink(struct DelimIndex *index);
+// 扫描 data 中 [from, to) 这段数据, 已经扫描过的部分不会重复扫描
+void delimIndexScan(struct DelimIndex *index, const char *data, int from, int to);
+// 在 [from, to) 中查找第一个字符 ch 的位置, 找不到返回 -1
+int delimIndexFind(struct DelimIndex *index, const char *data, int from, int to, char ch);
+// 在 [from, to) 中查找第一个 "\r\n" 的位置(指向 '\r'), 找不到返回 -1,
+// from 之前的分隔符不会再被使用, 下一次查找直接跳过它们
+int delimIndexFindCRLF(struct DelimIndex *index, const char *data, int from, int to);
@@ -2,6 +2,7 @@
 #include "Channel.h"
 #include "EventLoop.h"
 struct EventLoop;
+struct msghdr;
 
 struct Dispatcher
 {
@@ -14,7 +15,15 @@ struct Dispatcher
     // 修改
     int (*modify)(struct Channel *channel, struct EventLoop *evLoop);
     // 事件监测
-    int (*dispatch)(struct EventLoop *evLoop, int timeout); // 单位: s
+    int (*dispatch)(struct EventLoop *evLoop, int timeout); // 单位: ms
     // 清除数据(关闭fd或者释放内存)
     int (*clear)(struct EventLoop *evLoop);
+    // 完成模式(只有 io_uring 支持, 其他 dispatcher 为 NULL): 操作由内核完成之后在 dispatch 中调用 channel 的回调,
+    // 结果保存在 channel->result 中, 每个 channel 同时最多一个接收操作和一个发送操作
+    // accept -- multishot accept, 每接收一个连接调用一次读回调
+    int (*accept)(struct Channel *channel, struct EventLoop *evLoop);
+    // 接收 -- 数据写到 buf 中, 完成之后调用读回调
+    int (*recv)(struct Channel *channel, struct EventLoop *evLoop, void *buf, int size);
+    // 发送 -- 完成之后调用写回调, msg 和其中的 iovec 在完成之前必须保持有效
+    int (*sendmsg)(struct Channel *channel, struct EventLoop *evLoop, struct msghdr *msg);
 };
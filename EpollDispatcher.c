@@ -20,7 +20,7 @@ static void *epollInit();
 static int epollAdd(struct Channel *channel, struct EventLoop *evLoop);         // 添加事件
 static int epollRemove(struct Channel *channel, struct EventLoop *evLoop);      // 删除事件
 static int epollModify(struct Channel *channel, struct EventLoop *evLoop);      // 修改事件
-static int epollDispatch(struct EventLoop *evLoop, int timeout);                // 事件分发
+static int epollDispatch(struct EventLoop *evLoop, int timeout);                // 事件分发, 超时单位: ms
 static int epollClear(struct EventLoop *evLoop);                                // 清理 epoll
 static int epollCtl(struct Channel *channel, struct EventLoop *evLoop, int op); // 控制 epoll 操作
 
@@ -31,7 +31,10 @@ struct Dispatcher EpollDispatcher = {
     epollRemove,
     epollModify,
     epollDispatch,
-    epollClear};
+    epollClear,
+    NULL, // 不支持完成模式
+    NULL,
+    NULL};
 
 // 初始化 epoll
 static void *epollInit()
@@ -66,6 +69,10 @@ static int epollCtl(struct Channel *channel, struct EventLoop *evLoop, int op)
     {
         events |= EPOLLOUT; // 设置写事件
     }
+    if (channel->events & EdgeTrigger) // 检查是否是边沿触发
+    {
+        events |= EPOLLET; // 设置边沿触发
+    }
     ev.events = events; // 设置事件
     // 调用 epoll_ctl 函数
     int ret = epoll_ctl(data->epfd, op, channel->fd, &ev);
@@ -119,15 +126,15 @@ static int epollDispatch(struct EventLoop *evLoop, int timeout)
     // 获取 epoll 数据
     struct EpollData *data = (struct EpollData *)evLoop->dispatcherData;
     // 调用 epoll_wait 函数，等待事件发生
-    int count = epoll_wait(data->epfd, data->events, Max, timeout * 1000);
+    int count = epoll_wait(data->epfd, data->events, Max, timeout);
     for (int i = 0; i < count; ++i)
     {
         int events = data->events[i].events; // 获取事件
         int fd = data->events[i].data.fd;    // 获取文件描述符
         if (events & EPOLLERR || events & EPOLLHUP)
         {
-            // 对方断开了连接，继续处理其他事件
-            continue;
+            // 对方断开了连接, 按读事件处理, 由读回调发现连接断开并释放资源
+            events |= EPOLLIN;
         }
         if (events & EPOLLIN) // 处理读事件
         {
@@ -1,10 +1,50 @@
 #include "EventLoop.h"  // 包含自定义的 EventLoop 头文件
 #include <assert.h>     // 包含断言头文件，用于条件检查
-#include <sys/socket.h> // 包含套接字头文件
 #include <unistd.h>     // 包含 POSIX 操作系统 API，如 close, read, write
 #include <stdlib.h>     // 包含标准库函数，如 malloc, free
 #include <stdio.h>      // 标准输入输出库，用于 perror, printf 等函数
 #include <string.h>     // 字符串处理函数，如 strcpy, strlen
+#include <stdint.h>     // 包含 uint64_t
+#include <sys/eventfd.h> // 包含 eventfd, 用于跨线程唤醒事件循环
+#include <time.h>       // 包含 clock_gettime
+#include "MemPool.h"    // 包含每个线程的内存池
+
+// 新创建的事件循环使用的 dispatcher
+static struct Dispatcher *defaultDispatcher = &SelectDispatcher;
+
+// 选择 IO 多路复用模型
+struct Dispatcher *eventLoopSelectDispatcher(const char *name)
+{
+    if (strcmp(name, "epoll") == 0)
+    {
+        defaultDispatcher = &EpollDispatcher;
+    }
+    else if (strcmp(name, "poll") == 0)
+    {
+        defaultDispatcher = &PollDispatcher;
+    }
+    else if (strcmp(name, "select") == 0)
+    {
+        defaultDispatcher = &SelectDispatcher;
+    }
+    else if (strcmp(name, "io_uring") == 0)
+    {
+        // 运行时检测内核是否支持, 不支持则退回到 epoll
+        defaultDispatcher = ioUringSupported() ? &IoUringDispatcher : &EpollDispatcher;
+    }
+    else if (strcmp(name, "io_uring_completion") == 0)
+    {
+        if (!ioUringSupported())
+        {
+            defaultDispatcher = &EpollDispatcher;
+        }
+        else
+        {
+            defaultDispatcher = ioUringCompletionSupported() ? &IoUringCompletionDispatcher : &IoUringDispatcher;
+        }
+    }
+    return defaultDispatcher;
+}
 
 // 初始化事件循环，调用带线程名参数的初始化函数
 struct EventLoop *eventLoopInit()
@@ -12,19 +52,82 @@ struct EventLoop *eventLoopInit()
     return eventLoopInitEx(NULL);
 }
 
-// 写数据到本地通信的文件描述符
+// 初始化任务队列
+static void taskQueueInit(struct TaskQueue *queue)
+{
+    queue->stub.next = NULL;
+    queue->head = queue->tail = &queue->stub;
+}
+
+// 入队, 可以在任意线程中调用
+static void taskQueuePush(struct TaskQueue *queue, struct ChannelElement *node)
+{
+    __atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+    // 先抢占队尾, 再把前一个节点链接过来, 两步之间消费者会看到一个还没有链接上的节点
+    struct ChannelElement *prev = __atomic_exchange_n(&queue->head, node, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+// 出队, 只能在事件循环的线程中调用, 队列为空(或者生产者还没有链接完)返回 NULL
+static struct ChannelElement *taskQueuePop(struct TaskQueue *queue)
+{
+    struct ChannelElement *tail = queue->tail;
+    struct ChannelElement *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (tail == &queue->stub)
+    {
+        // 跳过哨兵节点
+        if (next == NULL)
+        {
+            return NULL;
+        }
+        queue->tail = tail = next;
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    }
+    if (next != NULL)
+    {
+        queue->tail = next;
+        return tail;
+    }
+    if (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE))
+    {
+        // 有生产者正在入队, 下一轮再取
+        return NULL;
+    }
+    // tail 是最后一个节点, 把哨兵节点放回队列之后才能把它取出来
+    taskQueuePush(queue, &queue->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next != NULL)
+    {
+        queue->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+// 队列中是否有任务(包括还没有链接完的节点)
+static bool taskQueueEmpty(struct TaskQueue *queue)
+{
+    return __atomic_load_n(&queue->head, __ATOMIC_SEQ_CST) == queue->tail &&
+           __atomic_load_n(&queue->tail->next, __ATOMIC_ACQUIRE) == NULL;
+}
+
+// 唤醒阻塞在 dispatch 中的事件循环
 void taskWakeup(struct EventLoop *evLoop)
 {
-    const char *msg = "我是要成为海贼王的男人!!!";  // 要写入的信息
-    write(evLoop->socketPair[0], msg, strlen(msg)); // 将消息写入 socketPair[0]
+    // 只有事件循环在睡眠的时候才需要写 eventfd, 多个生产者只有第一个会真正写入
+    if (__atomic_exchange_n(&evLoop->sleeping, 0, __ATOMIC_SEQ_CST))
+    {
+        uint64_t one = 1;
+        write(evLoop->wakeupFd, &one, sizeof(one));
+    }
 }
 
-// 读本地通信的文件描述符中的数据
+// 读 eventfd, 清除可读状态
 int readLocalMessage(void *arg)
 {
     struct EventLoop *evLoop = (struct EventLoop *)arg;
-    char buf[256];                                 // 缓冲区
-    read(evLoop->socketPair[1], buf, sizeof(buf)); // 从 socketPair[1] 中读取数据
+    uint64_t count;
+    read(evLoop->wakeupFd, &count, sizeof(count));
     return 0;
 }
 
@@ -34,29 +137,42 @@ struct EventLoop *eventLoopInitEx(const char *threadName)
     struct EventLoop *evLoop = (struct EventLoop *)malloc(sizeof(struct EventLoop)); // 分配事件循环结构体的内存
     evLoop->isQuit = false;                                                          // 初始化 isQuit 标志
     evLoop->threadID = pthread_self();                                               // 获取当前线程 ID
-    pthread_mutex_init(&evLoop->mutex, NULL);                                        // 初始化互斥锁
     strcpy(evLoop->threadName, threadName == NULL ? "MainThread" : threadName);      // 设置线程名
-    evLoop->dispatcher = &SelectDispatcher;                                          // 初始化 dispatcher
+    evLoop->dispatcher = defaultDispatcher;                                          // 初始化 dispatcher
     evLoop->dispatcherData = evLoop->dispatcher->init();                             // 初始化 dispatcher 数据
     // 初始化任务队列
-    evLoop->head = evLoop->tail = NULL;
+    taskQueueInit(&evLoop->taskQueue);
+    evLoop->sleeping = 0;
+    // 初始化负载统计
+    evLoop->connNum = 0;
+    evLoop->taskNum = 0;
+    evLoop->busyTime = 0;
+    // 初始化时间轮
+    evLoop->timerWheel = timerWheelInit();
     // 初始化 channelMap
     evLoop->channelMap = channelMapInit(128);
-    // 创建本地通信的 socketpair
-    int ret = socketpair(AF_UNIX, SOCK_STREAM, 0, evLoop->socketPair);
-    if (ret == -1)
+    // 创建用于唤醒事件循环的 eventfd, 多次写入会累加成一次可读事件
+    evLoop->wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (evLoop->wakeupFd == -1)
     {
-        perror("socketpair");
+        perror("eventfd");
         exit(0);
     }
-    // 指定规则: socketPair[0] 发送数据, socketPair[1] 接收数据
-    struct Channel *channel = channelInit(evLoop->socketPair[1], ReadEvent, readLocalMessage, NULL, NULL, evLoop);
+    struct Channel *channel = channelInit(evLoop->wakeupFd, ReadEvent, readLocalMessage, NULL, NULL, evLoop);
     // 将 channel 添加到任务队列
     eventLoopAddTask(evLoop, channel, ADD);
 
     return evLoop;
 }
 
+// 单调时钟的当前时间, 单位: us
+static int64_t monotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 // 启动事件循环
 int eventLoopRun(struct EventLoop *evLoop)
 {
@@ -71,8 +187,29 @@ int eventLoopRun(struct EventLoop *evLoop)
     // 循环处理事件
     while (!evLoop->isQuit)
     {
-        dispatcher->dispatch(evLoop, 2); // 调用 dispatch 函数，超时时长 2 秒
-        eventLoopProcessTask(evLoop);    // 处理任务队列中的任务
+        // 超时时长由最近要到期的定时器决定, 没有定时器最多等待 MaxLoopTimeout 毫秒
+        int timeout = timerWheelNextTimeout(evLoop->timerWheel);
+        if (timeout < 0 || timeout > MaxLoopTimeout)
+        {
+            timeout = MaxLoopTimeout;
+        }
+        // 先声明要睡眠再检查任务队列, 和 taskWakeup 配合保证不会丢失唤醒
+        __atomic_store_n(&evLoop->sleeping, 1, __ATOMIC_SEQ_CST);
+        if (!taskQueueEmpty(&evLoop->taskQueue))
+        {
+            timeout = 0;
+        }
+        evLoop->wakeTime = 0;
+        dispatcher->dispatch(evLoop, timeout);      // 调用 dispatch 函数
+        // 没有事件(超时)时 eventActivate 没有被调用, 在这里清除睡眠标志
+        __atomic_store_n(&evLoop->sleeping, 0, __ATOMIC_SEQ_CST);
+        int64_t now = monotonicUs();
+        eventLoopProcessTask(evLoop);               // 处理任务队列中的任务
+        timerWheelExpire(evLoop->timerWheel);       // 处理到期的定时器
+        // 统计这一轮处理事件的耗时(不包括阻塞等待的时间), 新的值占 1/8 的权重
+        int64_t busy = monotonicUs() - (evLoop->wakeTime != 0 ? evLoop->wakeTime : now);
+        int avg = __atomic_load_n(&evLoop->busyTime, __ATOMIC_RELAXED);
+        __atomic_store_n(&evLoop->busyTime, avg + (int)((busy - avg) / 8), __ATOMIC_RELAXED);
     }
     return 0;
 }
@@ -86,11 +223,28 @@ int eventActivate(struct EventLoop *evLoop, int fd, int event)
     }
     // 获取 fd 对应的 channel
     struct Channel *channel = evLoop->channelMap->list[fd];
+    if (channel == NULL)
+    {
+        return -1; // 连接已经在本轮事件处理中被关闭了
+    }
     assert(channel->fd == fd); // 检查 channel 的 fd 是否匹配
+    if (evLoop->wakeTime == 0)
+    {
+        evLoop->wakeTime = monotonicUs(); // 记录本轮开始处理事件的时间
+        // 等待已经返回了, 在执行回调之前就不再算作睡眠, 回调期间其他线程添加任务不需要写 eventfd,
+        // 这些任务在 dispatch 返回之后统一处理
+        __atomic_store_n(&evLoop->sleeping, 0, __ATOMIC_SEQ_CST);
+    }
     // 处理读事件
     if (event & ReadEvent && channel->readCallback)
     {
         channel->readCallback(channel->arg);
+        // 读回调中可能已经断开连接并释放了 channel
+        channel = evLoop->channelMap->list[fd];
+        if (channel == NULL)
+        {
+            return 0;
+        }
     }
     // 处理写事件
     if (event & WriteEvent && channel->writeCallback)
@@ -100,26 +254,11 @@ int eventActivate(struct EventLoop *evLoop, int fd, int event)
     return 0;
 }
 
-// 添加任务到任务队列
-int eventLoopAddTask(struct EventLoop *evLoop, struct Channel *channel, int type)
+// 添加任务节点到任务队列
+static int eventLoopAddElement(struct EventLoop *evLoop, struct ChannelElement *node)
 {
-    pthread_mutex_lock(&evLoop->mutex); // 加锁，保护共享资源
-    // 创建新的任务节点
-    struct ChannelElement *node = (struct ChannelElement *)malloc(sizeof(struct ChannelElement));
-    node->channel = channel;
-    node->type = type;
-    node->next = NULL;
-    // 如果任务队列为空
-    if (evLoop->head == NULL)
-    {
-        evLoop->head = evLoop->tail = node;
-    }
-    else
-    {
-        evLoop->tail->next = node; // 将新节点添加到队列末尾
-        evLoop->tail = node;       // 更新队列尾指针
-    }
-    pthread_mutex_unlock(&evLoop->mutex); // 解锁
+    __atomic_add_fetch(&evLoop->taskNum, 1, __ATOMIC_RELAXED);
+    taskQueuePush(&evLoop->taskQueue, node); // 无锁入队
     // 处理节点
     /*
      * 细节:
@@ -135,20 +274,44 @@ int eventLoopAddTask(struct EventLoop *evLoop, struct Channel *channel, int type
     }
     else
     {
-        // 主线程通知子线程处理任务队列
+        // 主线程通知子线程处理任务队列, 子线程没有睡眠时不需要通知
         taskWakeup(evLoop);
     }
     return 0;
 }
 
+// 添加任务到任务队列
+int eventLoopAddTask(struct EventLoop *evLoop, struct Channel *channel, int type)
+{
+    // 创建新的任务节点
+    // 任务节点从当前线程的内存池中分配, 处理完之后放回事件循环线程的内存池
+    struct ChannelElement *node = (struct ChannelElement *)memPoolAlloc(sizeof(struct ChannelElement));
+    node->channel = channel;
+    node->type = type;
+    node->func = NULL;
+    node->arg = NULL;
+    return eventLoopAddElement(evLoop, node);
+}
+
+// 在事件循环所在的线程中调用 func(arg)
+int eventLoopRunInLoop(struct EventLoop *evLoop, handleFunc func, void *arg)
+{
+    struct ChannelElement *node = (struct ChannelElement *)memPoolAlloc(sizeof(struct ChannelElement));
+    node->channel = NULL;
+    node->type = INVOKE;
+    node->func = func;
+    node->arg = arg;
+    return eventLoopAddElement(evLoop, node);
+}
+
 // 处理任务队列中的任务
 int eventLoopProcessTask(struct EventLoop *evLoop)
 {
-    pthread_mutex_lock(&evLoop->mutex);         // 加锁
-    struct ChannelElement *head = evLoop->head; // 获取任务队列的头节点
-    // 遍历任务队列
-    while (head != NULL)
+    // 依次取出任务, 任务中可能还会添加新的任务
+    struct ChannelElement *head;
+    while ((head = taskQueuePop(&evLoop->taskQueue)) != NULL)
     {
+        __atomic_sub_fetch(&evLoop->taskNum, 1, __ATOMIC_RELAXED);
         struct Channel *channel = head->channel;
         if (head->type == ADD)
         {
@@ -165,12 +328,13 @@ int eventLoopProcessTask(struct EventLoop *evLoop)
             // 修改事件
             eventLoopModify(evLoop, channel);
         }
-        struct ChannelElement *tmp = head;
-        head = head->next;
-        free(tmp); // 释放处理过的任务节点
+        else if (head->type == INVOKE)
+        {
+            // 调用函数
+            head->func(head->arg);
+        }
+        memPoolFree(head, sizeof(struct ChannelElement)); // 释放处理过的任务节点
     }
-    evLoop->head = evLoop->tail = NULL;   // 清空任务队列
-    pthread_mutex_unlock(&evLoop->mutex); // 解锁
     return 0;
 }
 
@@ -222,6 +386,48 @@ int eventLoopModify(struct EventLoop *evLoop, struct Channel *channel)
     return ret;
 }
 
+// 添加定时器
+void eventLoopAddTimer(struct EventLoop *evLoop, struct Timer *timer, int timeout)
+{
+    assert(evLoop->threadID == pthread_self()); // 时间轮不是线程安全的
+    timerWheelAdd(evLoop->timerWheel, timer, timeout);
+}
+
+// 取消定时器
+void eventLoopCancelTimer(struct EventLoop *evLoop, struct Timer *timer)
+{
+    timerWheelCancel(evLoop->timerWheel, timer);
+}
+
+bool eventLoopCompletionMode(struct EventLoop *evLoop)
+{
+    return evLoop->dispatcher->recv != NULL;
+}
+
+int eventLoopAccept(struct EventLoop *evLoop, struct Channel *channel)
+{
+    assert(evLoop->threadID == pthread_self());
+    return evLoop->dispatcher->accept(channel, evLoop);
+}
+
+int eventLoopRecv(struct EventLoop *evLoop, struct Channel *channel, void *buf, int size)
+{
+    assert(evLoop->threadID == pthread_self());
+    return evLoop->dispatcher->recv(channel, evLoop, buf, size);
+}
+
+int eventLoopSendMsg(struct EventLoop *evLoop, struct Channel *channel, struct msghdr *msg)
+{
+    assert(evLoop->threadID == pthread_self());
+    return evLoop->dispatcher->sendmsg(channel, evLoop, msg);
+}
+
+// 修改分配给事件循环的连接数
+void eventLoopUpdateConnNum(struct EventLoop *evLoop, int delta)
+{
+    __atomic_add_fetch(&evLoop->connNum, delta, __ATOMIC_RELAXED);
+}
+
 // 销毁 channel
 int destroyChannel(struct EventLoop *evLoop, struct Channel *channel)
 {
@@ -230,6 +436,6 @@ int destroyChannel(struct EventLoop *evLoop, struct Channel *channel)
     // 关闭 fd
     close(channel->fd);
     // 释放 channel
-    free(channel);
+    memPoolFree(channel, sizeof(struct Channel));
     return 0;
 }
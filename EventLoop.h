@@ -4,29 +4,52 @@
 #include "Dispatcher.h" // 包含 Dispatcher 头文件
 #include "ChannelMap.h" // 包含 ChannelMap 头文件
 #include <pthread.h>    // 包含 POSIX 线程库头文件
+#include "TimerWheel.h" // 包含定时器(时间轮)头文件
 
 // 声明外部的 Dispatcher 变量
 extern struct Dispatcher EpollDispatcher;
 extern struct Dispatcher PollDispatcher;
 extern struct Dispatcher SelectDispatcher;
+extern struct Dispatcher IoUringDispatcher;
+extern struct Dispatcher IoUringCompletionDispatcher;
+// 检测当前内核是否支持 io_uring
+bool ioUringSupported();
+// 检测当前内核是否支持 io_uring 的完成模式(accept, recv, sendmsg, 取消操作)
+bool ioUringCompletionSupported();
 
 // 定义处理节点中的 channel 的方式的枚举类型
 enum ElemType
 {
     ADD,    // 添加
     DELETE, // 删除
-    MODIFY  // 修改
+    MODIFY, // 修改
+    INVOKE  // 在事件循环所在的线程中调用 func(arg)
 };
 
+// 没有定时器的时候事件循环的最长等待时间, 单位: ms
+#define MaxLoopTimeout 2000
+
 // 定义任务队列的节点结构体
 struct ChannelElement
 {
     int type;                    // 如何处理该节点中的 channel
     struct Channel *channel;     // 指向 channel 结构体的指针
-    struct ChannelElement *next; // 指向下一个 ChannelElement 节点的指针
+    handleFunc func;             // INVOKE 类型的任务要调用的函数
+    void *arg;                   // 函数的参数
+    struct ChannelElement *next; // 指向下一个 ChannelElement 节点的指针, 由生产者原子地写入
+};
+
+// 无锁的多生产者单消费者任务队列(侵入式链表)
+// 生产者原子地交换 head 并把旧的 head 链接到新节点, 只有事件循环的线程从 tail 取节点
+struct TaskQueue
+{
+    struct ChannelElement *head; // 最后入队的节点, 多个线程同时修改
+    struct ChannelElement *tail; // 下一个要出队的节点, 只有事件循环的线程访问
+    struct ChannelElement stub;  // 哨兵节点, 队列为空时 head 和 tail 都指向它
 };
 
 struct Dispatcher; // 前向声明 Dispatcher 结构体
+struct msghdr;     // 前向声明 msghdr 结构体, 完成模式的发送操作使用
 
 // 定义事件循环结构体
 struct EventLoop
@@ -35,17 +58,28 @@ struct EventLoop
     struct Dispatcher *dispatcher; // 指向 Dispatcher 结构体的指针，epoll,poll,select
     void *dispatcherData;          // 指向 dispatcher 相关数据的指针
     // 任务队列
-    struct ChannelElement *head; // 任务队列的头指针
-    struct ChannelElement *tail; // 任务队列的尾指针
+    struct TaskQueue taskQueue; // 无锁任务队列, 其他线程通过它把任务交给当前线程
     // map,ChannelMap
     struct ChannelMap *channelMap; // 指向 ChannelMap 结构体的指针
-    // 线程 id, name, mutex
-    pthread_t threadID;    // 线程ID
-    char threadName[32];   // 线程名称
-    pthread_mutex_t mutex; // 互斥锁,用来保护任务队列的
-    int socketPair[2];     // 存储本地通信的文件描述符，通过 socketpair 初始化
+    // 线程 id, name
+    pthread_t threadID;  // 线程ID
+    char threadName[32]; // 线程名称
+    int wakeupFd;        // 用于唤醒事件循环的 eventfd
+    int sleeping;        // 事件循环是否阻塞在 dispatch 中, 只有这时才需要写 wakeupFd
+    // 定时器
+    struct TimerWheel *timerWheel; // 时间轮, 只在当前事件循环的线程中访问
+    // 负载统计, 主线程选择子线程的时候会读取, 都是原子操作
+    int connNum;  // 分配给当前事件循环的连接数
+    int taskNum;  // 任务队列中还没有处理的任务数
+    int busyTime; // 最近每一轮循环处理事件的平均耗时(指数加权平均), 单位: us
+    int64_t wakeTime; // 本轮 dispatch 返回后开始处理第一个事件的时间, 单位: us
 };
 
+// 选择之后创建的事件循环使用的 IO 多路复用模型: "epoll", "poll", "select", "io_uring", "io_uring_completion"
+// io_uring_completion: 接收/发送/accept 由 io_uring 完成, 不再是就绪之后再调用系统调用
+// 内核不支持完成模式时使用 io_uring, 不支持 io_uring 时使用 epoll, 返回实际选择的模型
+struct Dispatcher *eventLoopSelectDispatcher(const char *name);
+
 // 初始化事件循环
 struct EventLoop *eventLoopInit();                         // 初始化事件循环
 struct EventLoop *eventLoopInitEx(const char *threadName); // 带线程名的初始化，主要是主线程和子线程区分
@@ -59,6 +93,9 @@ int eventActivate(struct EventLoop *evLoop, int fd, int event); // 激活事件
 // 添加任务到任务队列
 int eventLoopAddTask(struct EventLoop *evLoop, struct Channel *channel, int type); // 添加任务
 
+// 在事件循环所在的线程中调用 func(arg), 如果当前就是该线程则立即调用
+int eventLoopRunInLoop(struct EventLoop *evLoop, handleFunc func, void *arg);
+
 // 处理任务队列中的任务
 int eventLoopProcessTask(struct EventLoop *evLoop); // 处理任务队列
 
@@ -67,5 +104,20 @@ int eventLoopAdd(struct EventLoop *evLoop, struct Channel *channel);    // 添
 int eventLoopRemove(struct EventLoop *evLoop, struct Channel *channel); // 删除事件
 int eventLoopModify(struct EventLoop *evLoop, struct Channel *channel); // 修改事件
 
+// 添加定时器, timeout 毫秒之后在事件循环的线程中调用定时器的回调函数, 只能在事件循环的线程中调用
+void eventLoopAddTimer(struct EventLoop *evLoop, struct Timer *timer, int timeout);
+// 取消定时器
+void eventLoopCancelTimer(struct EventLoop *evLoop, struct Timer *timer);
+
+// 完成模式: 当前事件循环的 dispatcher 是否支持由内核完成接收和发送
+bool eventLoopCompletionMode(struct EventLoop *evLoop);
+// 完成模式下提交操作, 只能在事件循环的线程中调用, 和 dispatch 的等待一起提交给内核
+int eventLoopAccept(struct EventLoop *evLoop, struct Channel *channel);
+int eventLoopRecv(struct EventLoop *evLoop, struct Channel *channel, void *buf, int size);
+int eventLoopSendMsg(struct EventLoop *evLoop, struct Channel *channel, struct msghdr *msg);
+
+// 修改分配给事件循环的连接数, 可以在任意线程中调用
+void eventLoopUpdateConnNum(struct EventLoop *evLoop, int delta);
+
 // 释放 channel
 int destroyChannel(struct EventLoop *evLoop, struct Channel *channel); // 销毁 channel
@@ -0,0 +1,286 @@
+#include "FileCache.h"
+#include "TimerWheel.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 每个线程一个缓存, 事件循环和线程一一对应
+static __thread struct FileCache *localCache = NULL;
+// 热点文件的限制, 所有线程共用
+static long hotBudget = HotCacheBudget;
+static int hotMaxSize = HotFileMaxSize;
+
+static unsigned int pathHash(const char *path)
+{
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for (; *path != '\0'; ++path)
+    {
+        hash = (hash ^ (unsigned char)*path) * 16777619u;
+    }
+    return hash;
+}
+
+static void lruRemove(struct FileCacheEntry *entry)
+{
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+}
+
+static void lruPushFront(struct FileCache *cache, struct FileCacheEntry *entry)
+{
+    entry->prev = &cache->lru;
+    entry->next = cache->lru.next;
+    cache->lru.next->prev = entry;
+    cache->lru.next = entry;
+}
+
+static void entryFree(struct FileCacheEntry *entry)
+{
+    if (entry->fd != -1)
+    {
+        close(entry->fd);
+    }
+    free(entry->content);
+    free(entry);
+}
+
+// 释放热点文件的内容, 正在使用的缓存项不能释放
+static void entryDropContent(struct FileCache *cache, struct FileCacheEntry *entry)
+{
+    cache->contentBytes -= entry->headLength + entry->bodyLength;
+    free(entry->content);
+    entry->content = NULL;
+    entry->headLength = entry->bodyLength = 0;
+}
+
+// 把缓存项从缓存中移除, 还有响应在使用的话等引用计数为 0 再释放
+static void fileCacheRemove(struct FileCache *cache, struct FileCacheEntry *entry)
+{
+    struct FileCacheEntry **pp = &cache->buckets[entry->hash % FileCacheBuckets];
+    while (*pp != entry)
+    {
+        pp = &(*pp)->hashNext;
+    }
+    *pp = entry->hashNext;
+    lruRemove(entry);
+    cache->num--;
+    entry->cached = false;
+    // 热点文件的内存从缓存中扣除, 内容等到没有响应使用之后再释放
+    cache->contentBytes -= entry->headLength + entry->bodyLength;
+    if (entry->refCount == 0)
+    {
+        entryFree(entry);
+    }
+}
+
+// 读取文件属性, 文件等到需要发送内容的时候再打开(304 之类的响应不需要打开文件)
+static void entryLoad(struct FileCacheEntry *entry)
+{
+    entry->fd = -1;
+    entry->openError = 0;
+    entry->error = stat(entry->path, &entry->st) == -1 ? errno : 0;
+    entry->expire = timerWheelNow() + FileCacheTTL;
+}
+
+// 缓存过期之后检查文件是否发生了变化
+static bool entryValid(struct FileCacheEntry *entry)
+{
+    struct stat st;
+    int error = stat(entry->path, &st) == -1 ? errno : 0;
+    if (error != entry->error)
+    {
+        return false;
+    }
+    if (error == 0 && (st.st_ino != entry->st.st_ino || st.st_dev != entry->st.st_dev ||
+                       st.st_size != entry->st.st_size || st.st_mtim.tv_sec != entry->st.st_mtim.tv_sec ||
+                       st.st_mtim.tv_nsec != entry->st.st_mtim.tv_nsec))
+    {
+        return false;
+    }
+    entry->expire = timerWheelNow() + FileCacheTTL;
+    return true;
+}
+
+struct FileCache *fileCacheLocal()
+{
+    if (localCache == NULL)
+    {
+        localCache = (struct FileCache *)calloc(1, sizeof(struct FileCache));
+        localCache->lru.prev = localCache->lru.next = &localCache->lru;
+    }
+    return localCache;
+}
+
+struct FileCacheEntry *fileCacheLookup(struct FileCache *cache, const char *path)
+{
+    if (strlen(path) >= sizeof(((struct FileCacheEntry *)0)->path))
+    {
+        return NULL;
+    }
+    unsigned int hash = pathHash(path);
+    struct FileCacheEntry *entry = cache->buckets[hash % FileCacheBuckets];
+    while (entry != NULL && (entry->hash != hash || strcmp(entry->path, path) != 0))
+    {
+        entry = entry->hashNext;
+    }
+    if (entry != NULL)
+    {
+        if (timerWheelNow() < entry->expire || entryValid(entry))
+        {
+            // 命中: 移动到 LRU 链表的头部
+            lruRemove(entry);
+            lruPushFront(cache, entry);
+            entry->refCount++;
+            entry->hits++;
+            return entry;
+        }
+        // 文件被修改了, 正在发送旧文件的响应继续使用旧的文件描述符
+        fileCacheRemove(cache, entry);
+    }
+    // 没有命中: 创建新的缓存项
+    entry = (struct FileCacheEntry *)malloc(sizeof(struct FileCacheEntry));
+    strcpy(entry->path, path);
+    entry->hash = hash;
+    entry->refCount = 1;
+    entry->hits = 0;
+    entry->content = NULL;
+    entry->headLength = entry->bodyLength = 0;
+    entry->encodedHead = false;
+    entry->sidecars = 0;
+    entry->sidecarExpire = 0;
+    entryLoad(entry);
+    // 缓存满了, 从 LRU 链表的尾部淘汰没有被使用的缓存项
+    struct FileCacheEntry *victim = cache->lru.prev;
+    while (cache->num >= FileCacheSize && victim != &cache->lru)
+    {
+        struct FileCacheEntry *prev = victim->prev;
+        if (victim->refCount == 0)
+        {
+            fileCacheRemove(cache, victim);
+        }
+        victim = prev;
+    }
+    if (cache->num >= FileCacheSize)
+    {
+        // 所有的缓存项都在使用中, 这个文件不缓存, 释放引用的时候直接关闭
+        entry->cached = false;
+        return entry;
+    }
+    entry->cached = true;
+    entry->hashNext = cache->buckets[hash % FileCacheBuckets];
+    cache->buckets[hash % FileCacheBuckets] = entry;
+    lruPushFront(cache, entry);
+    cache->num++;
+    return entry;
+}
+
+int fileCacheOpen(struct FileCacheEntry *entry)
+{
+    if (entry->fd == -1 && entry->openError == 0 && entry->error == 0 && S_ISREG(entry->st.st_mode))
+    {
+        entry->fd = open(entry->path, O_RDONLY | O_CLOEXEC);
+        entry->openError = entry->fd == -1 ? errno : 0;
+    }
+    return entry->fd;
+}
+
+bool fileCacheSidecarsValid(struct FileCacheEntry *entry)
+{
+    return entry->sidecarExpire != 0 && timerWheelNow() < entry->sidecarExpire;
+}
+
+void fileCacheSetSidecars(struct FileCacheEntry *entry, unsigned int sidecars)
+{
+    entry->sidecars = sidecars;
+    entry->sidecarExpire = timerWheelNow() + FileCacheTTL;
+}
+
+void fileCacheRetain(struct FileCacheEntry *entry)
+{
+    entry->refCount++;
+}
+
+void fileCacheRelease(struct FileCacheEntry *entry)
+{
+    if (--entry->refCount == 0 && !entry->cached)
+    {
+        entryFree(entry);
+    }
+}
+
+void fileCacheSetHotLimit(long budget, int maxFileSize)
+{
+    hotBudget = budget;
+    hotMaxSize = maxFileSize;
+}
+
+bool fileCacheHotCandidate(struct FileCacheEntry *entry)
+{
+    return entry->cached && entry->content == NULL && entry->fd != -1 &&
+           entry->hits >= HotFileMinHits && entry->st.st_size <= hotMaxSize &&
+           entry->st.st_size <= hotBudget;
+}
+
+// 热点文件的内存不够时, 从 LRU 链表的尾部开始释放没有被使用的热点文件
+static bool contentReserve(struct FileCache *cache, long size)
+{
+    struct FileCacheEntry *victim = cache->lru.prev;
+    while (cache->contentBytes + size > hotBudget && victim != &cache->lru)
+    {
+        if (victim->content != NULL && victim->refCount == 0)
+        {
+            entryDropContent(cache, victim);
+        }
+        victim = victim->prev;
+    }
+    return cache->contentBytes + size <= hotBudget;
+}
+
+bool fileCacheSetContent(struct FileCacheEntry *entry, const char *head, int headLength)
+{
+    struct FileCache *cache = fileCacheLocal();
+    long size = headLength + entry->st.st_size;
+    if (!contentReserve(cache, size))
+    {
+        return false;
+    }
+    char *content = (char *)malloc(size);
+    memcpy(content, head, headLength);
+    if (pread(entry->fd, content + headLength, entry->st.st_size, 0) != entry->st.st_size)
+    {
+        // 文件在读取的过程中被修改了
+        free(content);
+        return false;
+    }
+    entry->content = content;
+    entry->headLength = headLength;
+    entry->bodyLength = entry->st.st_size;
+    cache->contentBytes += size;
+    return true;
+}
+
+bool fileCachePageCandidate(struct FileCacheEntry *entry)
+{
+    return entry->cached && entry->content == NULL && hotBudget > 0;
+}
+
+bool fileCacheSetPage(struct FileCacheEntry *entry, const char *head, int headLength, const char *body, int bodyLength)
+{
+    struct FileCache *cache = fileCacheLocal();
+    long size = (long)headLength + bodyLength;
+    if (!contentReserve(cache, size))
+    {
+        return false;
+    }
+    char *content = (char *)malloc(size);
+    memcpy(content, head, headLength);
+    memcpy(content + headLength, body, bodyLength);
+    entry->content = content;
+    entry->headLength = headLength;
+    entry->bodyLength = bodyLength;
+    cache->contentBytes += size;
+    return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+// 文件缓存: 缓存静态资源的 stat 结果和打开的文件描述符, 命中时不需要再调用 stat/open
+// 每个事件循环(线程)有自己的缓存, 不需要加锁
+#define FileCacheSize 128    // 每个线程最多缓存的文件个数, 每个普通文件占用一个文件描述符
+#define FileCacheBuckets 256 // 哈希表的桶数
+#define FileCacheTTL 2000    // 缓存项的有效期(ms), 过期之后重新 stat 检查文件是否被修改
+// 热点文件: 被多次请求的小文件把整个响应(状态行, 响应头, 文件内容)序列化之后保存在内存中
+#define HotCacheBudget (8 * 1024 * 1024) // 默认每个线程最多使用的内存
+#define HotFileMaxSize (64 * 1024)       // 默认单个文件的大小上限
+#define HotFileMinHits 2                 // 命中这么多次之后才放到内存中
+
+struct FileCacheEntry
+{
+    char path[256];
+    unsigned int hash;
+    int error;       // stat 失败时的 errno, 0 表示文件存在(失败的结果也缓存, 404 同样不需要 stat)
+    struct stat st;  // 文件属性
+    int fd;          // 普通文件打开的文件描述符, 第一次需要发送文件内容时才打开, 没有打开为 -1
+    int openError;   // 打开文件失败时的 errno, 失败的结果同样缓存
+    uint64_t expire; // 过期时间, 单位: ms
+    int refCount;    // 正在使用这个缓存项的响应个数, 被淘汰时等引用计数为 0 才关闭文件
+    bool cached;     // 是否还在缓存中
+    int hits;        // 命中次数
+    // 热点文件的内容: 序列化好的状态行和响应头(不包括 Connection 和结尾的空行) + 文件内容,
+    // 目录保存的是生成好的目录列表页面, 目录的修改时间变化之后缓存项被移除, 页面重新生成
+    char *content;
+    int headLength;
+    int bodyLength;
+    bool encodedHead; // 响应头是不是作为压缩版本(带 Content-Encoding)发送时的响应头
+    // 预先压缩好的版本是否存在, 第 i 位对应使用者定义的第 i 种压缩版本, 探测结果和缓存项一样按照 TTL 重新检查,
+    // 不为每个压缩文件单独创建缓存项, 不存在的压缩文件不占用缓存
+    unsigned int sidecars;
+    uint64_t sidecarExpire; // 过期时间, 0 表示还没有探测过
+    struct FileCacheEntry *hashNext;
+    struct FileCacheEntry *prev; // LRU 链表, 链表头部是最近使用的
+    struct FileCacheEntry *next;
+};
+
+struct FileCache
+{
+    struct FileCacheEntry *buckets[FileCacheBuckets];
+    struct FileCacheEntry lru; // LRU 链表的头节点
+    int num;
+    long contentBytes; // 热点文件占用的内存
+};
+
+// 得到当前线程的文件缓存, 第一次调用时创建
+struct FileCache *fileCacheLocal();
+// 查找文件, 没有缓存或者缓存过期时调用 stat 并更新缓存
+// 返回的缓存项引用计数加 1, 使用完毕之后调用 fileCacheRelease; 路径太长返回 NULL
+struct FileCacheEntry *fileCacheLookup(struct FileCache *cache, const char *path);
+// 打开普通文件(只打开一次, 文件描述符属于缓存项), 失败或者不是普通文件返回 -1
+int fileCacheOpen(struct FileCacheEntry *entry);
+// 缓存项中记录的压缩版本是否还有效, 没有探测过或者已经过期返回 false
+bool fileCacheSidecarsValid(struct FileCacheEntry *entry);
+// 记录压缩版本的探测结果, FileCacheTTL 之后需要重新探测
+void fileCacheSetSidecars(struct FileCacheEntry *entry, unsigned int sidecars);
+// 增加对缓存项的引用, 例如输出链中还在发送缓存项的内容
+void fileCacheRetain(struct FileCacheEntry *entry);
+// 释放对缓存项的引用
+void fileCacheRelease(struct FileCacheEntry *entry);
+// 设置热点文件缓存的内存上限和单个文件的大小上限, 需要在启动服务器之前设置, budget 为 0 表示不缓存
+void fileCacheSetHotLimit(long budget, int maxFileSize);
+// 是否应该把这个文件的内容放到内存中
+bool fileCacheHotCandidate(struct FileCacheEntry *entry);
+// 把序列化好的响应头和文件内容保存到缓存项中, 内存不够时先淘汰最久没有使用的热点文件
+bool fileCacheSetContent(struct FileCacheEntry *entry, const char *head, int headLength);
+// 是否应该缓存这个目录生成的列表页面(不受单个文件大小的限制, 只受内存上限的限制)
+bool fileCachePageCandidate(struct FileCacheEntry *entry);
+// 把序列化好的响应头和生成好的页面保存到缓存项中
+bool fileCacheSetPage(struct FileCacheEntry *entry, const char *head, int headLength, const char *body, int bodyLength);
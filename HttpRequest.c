@@ -11,13 +11,22 @@
 #include "TcpConnection.h"
 #include <assert.h>
 #include <ctype.h>
+#include <time.h>
+#include "MemPool.h"
+#include "MimeType.h"
 
-#define HeaderSize 12
+static void cacheDirPage(struct HttpResponse* response, struct FileCacheEntry* entry);
+
+#define HeaderSize 32
 struct HttpRequest* httpRequestInit()
 {
-    struct HttpRequest* request = (struct HttpRequest*)malloc(sizeof(struct HttpRequest));
+    struct HttpRequest* request = (struct HttpRequest*)memPoolAlloc(sizeof(struct HttpRequest));
+    request->zeroCopy = false;
+    request->readBuf = NULL;
+    delimIndexInit(&request->delims);
+    request->delimBase = 0;
     httpRequestReset(request);
-    request->reqHeaders = (struct RequestHeader*)malloc(sizeof(struct RequestHeader) * HeaderSize);
+    request->reqHeaders = (struct RequestHeader*)memPoolAlloc(sizeof(struct RequestHeader) * HeaderSize);
     return request;
 }
 
@@ -28,22 +37,36 @@ void httpRequestReset(struct HttpRequest* req)
     req->url = NULL;
     req->version = NULL;
     req->reqHeadersNum = 0;
+    req->ownStrings = !req->zeroCopy;
 }
 
 void httpRequestResetEx(struct HttpRequest* req)
 {
-    free(req->url);
-    free(req->method);
-    free(req->version);
-    if (req->reqHeaders != NULL)
+    if (req->ownStrings)
     {
-        for (int i = 0; i < req->reqHeadersNum; ++i)
+        free(req->url);
+        free(req->method);
+        free(req->version);
+        if (req->reqHeaders != NULL)
         {
-            free(req->reqHeaders[i].key);
-            free(req->reqHeaders[i].value);
+            for (int i = 0; i < req->reqHeadersNum; ++i)
+            {
+                free(req->reqHeaders[i].key);
+                free(req->reqHeaders[i].value);
+            }
         }
-        free(req->reqHeaders);
     }
+    if (req->readBuf != NULL)
+    {
+        // 请求处理完了, 读缓冲区可以重新整理内存了; 分隔符索引只保留后面还没有解析的数据,
+        // 记录当前的 readPos, 下一个请求开始时据此修正偏移量
+        delimIndexRebase(&req->delims, req->readBuf->readPos, 0);
+        delimIndexShrink(&req->delims);
+        req->delimBase = req->readBuf->readPos;
+        bufferUnpin(req->readBuf);
+        req->readBuf = NULL;
+    }
+    // 请求头数组保留, 长连接中的下一个请求继续使用
     httpRequestReset(req);
 }
 
@@ -52,12 +75,77 @@ void httpRequestDestroy(struct HttpRequest* req)
     if (req != NULL)
     {
         httpRequestResetEx(req);
-        free(req);
+        delimIndexDestroy(&req->delims);
+        memPoolFree(req->reqHeaders, sizeof(struct RequestHeader) * HeaderSize);
+        memPoolFree(req, sizeof(struct HttpRequest));
     }
 }
 
+void httpRequestSetZeroCopy(struct HttpRequest* req, bool zeroCopy)
+{
+    req->zeroCopy = zeroCopy;
+    req->ownStrings = !zeroCopy;
+}
+
+void httpRequestMaterialize(struct HttpRequest* req)
+{
+    if (req->ownStrings || req->curState != ParseReqDone)
+    {
+        return;
+    }
+    req->method = strdup(req->method);
+    req->url = strdup(req->url);
+    req->version = strdup(req->version);
+    for (int i = 0; i < req->reqHeadersNum; ++i)
+    {
+        req->reqHeaders[i].key = strdup(req->reqHeaders[i].key);
+        req->reqHeaders[i].value = strdup(req->reqHeaders[i].value);
+    }
+    req->ownStrings = true;
+}
+
+// 零拷贝模式下请求解析完毕, 让各个字段指向读缓冲区中的数据
+static void httpRequestBindSlices(struct HttpRequest* request)
+{
+    struct Buffer* readBuf = request->readBuf;
+    request->method = bufferSliceData(readBuf, &request->methodSlice);
+    request->url = bufferSliceData(readBuf, &request->urlSlice);
+    request->version = bufferSliceData(readBuf, &request->versionSlice);
+    for (int i = 0; i < request->reqHeadersNum; ++i)
+    {
+        request->reqHeaders[i].key = bufferSliceData(readBuf, &request->reqHeaders[i].keySlice);
+        request->reqHeaders[i].value = bufferSliceData(readBuf, &request->reqHeaders[i].valueSlice);
+    }
+}
+
+// 保存请求中的一个字段: 零拷贝模式下只记录位置, 并把字段后面的分隔符(空格, ':', '\r')改成字符串结束符,
+// 这部分数据已经解析过了, 修改它不会有影响; 否则申请内存拷贝一份
+static void httpRequestSaveField(struct HttpRequest* request, struct Buffer* readBuf,
+    char* start, int length, char** ptr, struct BufferSlice* slice)
+{
+    if (request->zeroCopy)
+    {
+        slice->offset = start - readBuf->data;
+        slice->length = length;
+        start[length] = '\0';
+        *ptr = NULL;
+        return;
+    }
+    char* tmp = (char*)malloc(length + 1);
+    strncpy(tmp, start, length);
+    tmp[length] = '\0';
+    *ptr = tmp;
+}
+
 void httpRequestAddHeader(struct HttpRequest* request, const char* key, const char* value)
 {
+    if (request->reqHeadersNum >= HeaderSize)
+    {
+        // 请求头数组已满, 丢弃多余的请求头
+        free((char*)key);
+        free((char*)value);
+        return;
+    }
     request->reqHeaders[request->reqHeadersNum].key = (char*)key;
     request->reqHeaders[request->reqHeadersNum].value = (char*)value;
     request->reqHeadersNum++;
@@ -69,7 +157,8 @@ char* httpRequestGetHeader(struct HttpRequest* request, const char* key)
     {
         for (int i = 0; i < request->reqHeadersNum; ++i)
         {
-            if (strncasecmp(request->reqHeaders[i].key, key, strlen(key)) == 0)
+            // 比较完整的名字: Range, If-Range, Content-Length 等决定了如何处理请求, 不能匹配到 Range-Foo 这样的请求头
+            if (strcasecmp(request->reqHeaders[i].key, key) == 0)
             {
                 return request->reqHeaders[i].value;
             }
@@ -78,36 +167,91 @@ char* httpRequestGetHeader(struct HttpRequest* request, const char* key)
     return NULL;
 }
 
-char* splitRequestLine(const char* start, const char* end, const char* sub, char** ptr)
+bool httpRequestKeepAlive(struct HttpRequest* request)
+{
+    char* conn = httpRequestGetHeader(request, "Connection");
+    // HTTP/1.1 默认是长连接, 除非客户端指定 Connection: close
+    if (request->version != NULL && strcasecmp(request->version, "HTTP/1.1") == 0)
+    {
+        return conn == NULL || strcasecmp(conn, "close") != 0;
+    }
+    // HTTP/1.0 默认是短连接, 除非客户端指定 Connection: keep-alive
+    return conn != NULL && strcasecmp(conn, "keep-alive") == 0;
+}
+
+// 请求是否带有请求体: 服务器不读取请求体, 回复之后必须断开连接, 否则请求体会被当成下一个请求解析
+static bool httpRequestHasBody(struct HttpRequest* request)
+{
+    char* length = httpRequestGetHeader(request, "Content-Length");
+    return httpRequestGetHeader(request, "Transfer-Encoding") != NULL ||
+        (length != NULL && strcmp(length, "0") != 0);
+}
+
+// 通过分隔符索引找到读缓冲区中的下一个 \r\n
+static char* httpRequestFindCRLF(struct HttpRequest* request, struct Buffer* readBuf)
+{
+    int pos = delimIndexFindCRLF(&request->delims, readBuf->data, readBuf->readPos, readBuf->writePos);
+    return pos == -1 ? NULL : readBuf->data + pos;
+}
+
+// 通过分隔符索引在 [start, end) 中查找字符 ch
+static char* httpRequestFindDelim(struct HttpRequest* request, struct Buffer* readBuf,
+    char* start, char* end, char ch)
+{
+    int pos = delimIndexFind(&request->delims, readBuf->data, start - readBuf->data, end - readBuf->data, ch);
+    return pos == -1 ? NULL : readBuf->data + pos;
+}
+
+char* splitRequestLine(struct HttpRequest* request, struct Buffer* readBuf,
+    char* start, char* end, char sep, char** ptr, struct BufferSlice* slice)
 {
     char* space = end;
-    if (sub != NULL)
+    if (sep != '\0')
     {
-        space = memmem(start, end - start, sub, strlen(sub));
-        assert(space != NULL);
+        space = httpRequestFindDelim(request, readBuf, start, end, sep);
+        if (space == NULL)
+        {
+            return NULL;
+        }
     }
-    int length = space - start;
-    char* tmp = (char*)malloc(length + 1);
-    strncpy(tmp, start, length);
-    tmp[length] = '\0';
-    *ptr = tmp;
+    httpRequestSaveField(request, readBuf, start, space - start, ptr, slice);
     return space + 1;
 }
 
 bool parseHttpRequestLine(struct HttpRequest* request, struct Buffer* readBuf)
 {
     // 读出请求行, 保存字符串结束地址
-    char* end = bufferFindCRLF(readBuf);
+    char* end = httpRequestFindCRLF(request, readBuf);
+    if (end == NULL)
+    {
+        // 请求行还没有接收完整
+        return false;
+    }
     // 保存字符串起始地址
     char* start = readBuf->data + readBuf->readPos;
     // 请求行总长度
     int lineSize = end - start;
 
-    if (lineSize)
+    if (lineSize == 0)
+    {
+        // 长连接中两个请求之间可能有多余的空行, 跳过
+        readBuf->readPos += 2;
+        return true;
+    }
+    else
     {
-        start = splitRequestLine(start, end, " ", &request->method);
-        start = splitRequestLine(start, end, " ", &request->url);
-        splitRequestLine(start, end, NULL, &request->version);
+        start = splitRequestLine(request, readBuf, start, end, ' ', &request->method, &request->methodSlice);
+        if (start != NULL)
+        {
+            start = splitRequestLine(request, readBuf, start, end, ' ', &request->url, &request->urlSlice);
+        }
+        if (start == NULL)
+        {
+            // 请求行格式错误
+            request->curState = ParseReqError;
+            return false;
+        }
+        splitRequestLine(request, readBuf, start, end, '\0', &request->version, &request->versionSlice);
 #if 0
         // get /xxx/xx.txt http/1.1
         // 请求方式
@@ -144,51 +288,84 @@ bool parseHttpRequestLine(struct HttpRequest* request, struct Buffer* readBuf)
         request->curState = ParseReqHeaders;
         return true;
     }
-    return false;
 }
 
-// 该函数处理请求头中的一行
+// 该函数处理请求头中的一行: "key:value", 冒号两边可以有空白(空格或者 \t), 空行表示请求头结束
 bool parseHttpRequestHeader(struct HttpRequest* request, struct Buffer* readBuf)
 {
-    char* end = bufferFindCRLF(readBuf);
-    if (end != NULL)
+    char* end = httpRequestFindCRLF(request, readBuf);
+    if (end == NULL)
     {
-        char* start = readBuf->data + readBuf->readPos;
-        int lineSize = end - start;
-        // 基于: 搜索字符串
-        char* middle = memmem(start, lineSize, ": ", 2);
-        if (middle != NULL)
-        {
-            char* key = malloc(middle - start + 1);
-            strncpy(key, start, middle - start);
-            key[middle - start] = '\0';
-
-            char* value = malloc(end - middle - 2 + 1);
-            strncpy(value, middle + 2, end - middle - 2);
-            value[end - middle - 2] = '\0';
-
-            httpRequestAddHeader(request, key, value);
-            // 移动读数据的位置
-            readBuf->readPos += lineSize;
-            readBuf->readPos += 2;
-        }
-        else
-        {
-            // 请求头被解析完了, 跳过空行
-            readBuf->readPos += 2;
-            // 修改解析状态
-            // 忽略 post 请求, 按照 get 请求处理
-            request->curState = ParseReqDone;
-        }
+        return false;
+    }
+    char* start = readBuf->data + readBuf->readPos;
+    int lineSize = end - start;
+    if (lineSize == 0)
+    {
+        // 请求头被解析完了, 跳过空行
+        readBuf->readPos += 2;
+        // 修改解析状态, 请求体不读取, 带有请求体的请求回复之后断开连接
+        request->curState = ParseReqDone;
         return true;
     }
-    return false;
+    // 基于分隔符索引查找第一个 ':'
+    char* middle = httpRequestFindDelim(request, readBuf, start, end, ':');
+    if (middle == NULL || middle == start)
+    {
+        // 不是空行也没有键, 请求头格式错误
+        request->curState = ParseReqError;
+        return false;
+    }
+    // 去掉键后面和值两边的空白
+    char* keyEnd = middle;
+    while (keyEnd > start && (keyEnd[-1] == ' ' || keyEnd[-1] == '\t'))
+    {
+        keyEnd--;
+    }
+    char* value = middle + 1;
+    while (value < end && (*value == ' ' || *value == '\t'))
+    {
+        value++;
+    }
+    char* valueEnd = end;
+    while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+    {
+        valueEnd--;
+    }
+    char* key;
+    char* val;
+    struct BufferSlice keySlice, valueSlice;
+    httpRequestSaveField(request, readBuf, start, keyEnd - start, &key, &keySlice);
+    httpRequestSaveField(request, readBuf, value, valueEnd - value, &val, &valueSlice);
+    if (request->reqHeadersNum < HeaderSize)
+    {
+        request->reqHeaders[request->reqHeadersNum].keySlice = keySlice;
+        request->reqHeaders[request->reqHeadersNum].valueSlice = valueSlice;
+    }
+    httpRequestAddHeader(request, key, val);
+    // 移动读数据的位置
+    readBuf->readPos += lineSize;
+    readBuf->readPos += 2;
+    return true;
 }
 
 bool parseHttpRequest(struct HttpRequest* request, struct Buffer* readBuf,
     struct HttpResponse* response, struct Buffer* sendBuf, int socket)
 {
     bool flag = true;
+    if (request->readBuf == NULL)
+    {
+        // 两个请求之间 readPos 只会因为缓冲区整理内存(数据移动到开始位置)而改变, 修正分隔符索引的偏移量
+        if (readBuf->readPos != request->delimBase)
+        {
+            delimIndexRebase(&request->delims, 0, request->delimBase - readBuf->readPos);
+        }
+        // 分隔符索引(以及零拷贝模式下的切片)记录的是偏移量, 请求解析完之前读缓冲区不能移动数据
+        bufferPin(readBuf);
+        request->readBuf = readBuf;
+    }
+    // 只扫描新接收到的数据
+    delimIndexScan(&request->delims, readBuf->data, readBuf->readPos, readBuf->writePos);
     while (request->curState != ParseReqDone)
     {
         switch (request->curState)
@@ -202,6 +379,7 @@ bool parseHttpRequest(struct HttpRequest* request, struct Buffer* readBuf,
         case ParseReqBody:
             break;
         default:
+            flag = false;
             break;
         }
         if (!flag)
@@ -211,23 +389,428 @@ bool parseHttpRequest(struct HttpRequest* request, struct Buffer* readBuf,
         // 判断是否解析完毕了, 如果完毕了, 需要准备回复的数据
         if (request->curState == ParseReqDone)
         {
+            if (request->zeroCopy)
+            {
+                httpRequestBindSlices(request);
+            }
+            // response->keepAlive 由连接预先设置(是否还允许复用), 再结合客户端的意愿
+            response->keepAlive = response->keepAlive && httpRequestKeepAlive(request) &&
+                !httpRequestHasBody(request);
             // 1. 根据解析出的原始数据, 对客户端的请求做出处理
             processHttpRequest(request, response);
+            httpResponseAddHeader(response, "Connection", response->keepAlive ? "keep-alive" : "close");
             // 2. 组织响应数据并发送给客户端
             httpResponsePrepareMsg(response, sendBuf, socket);
+            if (strcasecmp(request->method, "head") == 0)
+            {
+                // HEAD 请求: 响应头和 GET 请求完全一样, 只是不发送响应体
+                response->sendDataFunc = NULL;
+                response->bodyLength = 0;
+            }
         }
     }
-    request->curState = ParseReqLine;   // 状态还原, 保证还能继续处理第二条及以后的请求
+    httpRequestResetEx(request);   // 状态还原, 保证还能继续处理第二条及以后的请求
     return flag;
 }
 
-// 处理基于get的http请求
-bool processHttpRequest(struct HttpRequest* request, struct HttpResponse* response)
+// 预先压缩好的文件(file.br, file.gz), 按照优先级排列
+static const struct
+{
+    const char* name;
+    const char* suffix;
+} encodedFiles[] = {
+    { "br", ".br" },
+    { "gzip", ".gz" },
+};
+
+// 客户端是否接受这种编码: 出现在 Accept-Encoding 中(或者是 *)并且 q 不为 0
+static bool acceptEncoding(const char* accept, const char* name)
+{
+    int length = strlen(name);
+    bool wildcard = false;
+    const char* p = accept;
+    while (*p != '\0')
+    {
+        const char* end = strchr(p, ',');
+        if (end == NULL)
+        {
+            end = p + strlen(p);
+        }
+        while (p < end && *p == ' ')
+        {
+            p++;
+        }
+        int tokenSize = 0;
+        while (p + tokenSize < end && p[tokenSize] != ';' && p[tokenSize] != ' ')
+        {
+            tokenSize++;
+        }
+        bool exact = tokenSize == length && strncasecmp(p, name, length) == 0;
+        if (exact || (tokenSize == 1 && *p == '*'))
+        {
+            // 查找权重 q=
+            bool allowed = true;
+            for (const char* c = p + tokenSize; c + 1 < end; ++c)
+            {
+                if ((c[0] == 'q' || c[0] == 'Q') && c[1] == '=')
+                {
+                    allowed = atof(c + 2) > 0;
+                    break;
+                }
+            }
+            if (exact)
+            {
+                return allowed;
+            }
+            wildcard = allowed;
+        }
+        p = *end == '\0' ? end : end + 1;
+    }
+    return wildcard;
+}
+
+// 压缩文件比原文件旧说明原文件修改之后还没有重新压缩, 不能使用
+static bool encodedUsable(const struct stat* encoded, const struct stat* st)
+{
+    return S_ISREG(encoded->st_mode) &&
+        (encoded->st_mtim.tv_sec > st->st_mtim.tv_sec ||
+        (encoded->st_mtim.tv_sec == st->st_mtim.tv_sec && encoded->st_mtim.tv_nsec >= st->st_mtim.tv_nsec));
+}
+
+// 查找比原文件新的压缩文件, 客户端接受时返回它的缓存项(持有一个引用)并通过 encoding 传出编码,
+// vary 表示这个文件存在压缩版本, 响应中需要添加 Vary 响应头
+// 哪些压缩版本存在记录在原文件的缓存项中, 只有真正发送压缩文件时才为它创建缓存项
+static struct FileCacheEntry* findEncodedFile(struct FileCache* cache, const char* file,
+    struct FileCacheEntry* entry, const char* accept, const char** encoding, bool* vary)
+{
+    char path[256];
+    int num = (int)(sizeof(encodedFiles) / sizeof(encodedFiles[0]));
+    if (!fileCacheSidecarsValid(entry))
+    {
+        unsigned int sidecars = 0;
+        for (int i = 0; i < num; ++i)
+        {
+            struct stat st;
+            if (snprintf(path, sizeof(path), "%s%s", file, encodedFiles[i].suffix) < (int)sizeof(path) &&
+                stat(path, &st) == 0 && encodedUsable(&st, &entry->st))
+            {
+                sidecars |= 1u << i;
+            }
+        }
+        fileCacheSetSidecars(entry, sidecars);
+    }
+    *vary = entry->sidecars != 0;
+    if (accept == NULL)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < num; ++i)
+    {
+        if (!(entry->sidecars & (1u << i)) || !acceptEncoding(accept, encodedFiles[i].name))
+        {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s%s", file, encodedFiles[i].suffix);
+        struct FileCacheEntry* encoded = fileCacheLookup(cache, path);
+        if (encoded == NULL)
+        {
+            continue;
+        }
+        // 探测之后压缩文件可能又被修改或者删除了
+        if (encoded->error == 0 && encodedUsable(&encoded->st, &entry->st) && fileCacheOpen(encoded) != -1)
+        {
+            *encoding = encodedFiles[i].name;
+            return encoded;
+        }
+        fileCacheRelease(encoded);
+    }
+    return NULL;
+}
+
+// 把时间格式化为 http 使用的格式: Sun, 06 Nov 1994 08:49:37 GMT
+static void httpDate(time_t t, char* buf, int size)
+{
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(buf, size, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+// 文件的验证器: ETag 由 inode, 文件大小和修改时间生成, Last-Modified 是修改时间
+static void fileValidators(struct FileCacheEntry* entry, char* etag, int etagSize, char* lastModified, int dateSize)
+{
+    snprintf(etag, etagSize, "\"%lx-%lx-%lx%09lx\"", (unsigned long)entry->st.st_ino,
+        (unsigned long)entry->st.st_size, (unsigned long)entry->st.st_mtim.tv_sec,
+        (unsigned long)entry->st.st_mtim.tv_nsec);
+    httpDate(entry->st.st_mtime, lastModified, dateSize);
+}
+
+// If-None-Match 中是否有和 etag 相同的值(弱比较, 忽略 W/ 前缀), * 匹配任何 etag
+static bool etagListMatch(const char* list, const char* etag)
+{
+    int length = strlen(etag);
+    const char* p = list;
+    while (*p != '\0')
+    {
+        while (*p == ' ' || *p == ',')
+        {
+            p++;
+        }
+        if (*p == '*')
+        {
+            return true;
+        }
+        if (strncmp(p, "W/", 2) == 0)
+        {
+            p += 2;
+        }
+        if (strncmp(p, etag, length) == 0 && (p[length] == '\0' || p[length] == ',' || p[length] == ' '))
+        {
+            return true;
+        }
+        const char* end = strchr(p, ',');
+        if (end == NULL)
+        {
+            break;
+        }
+        p = end;
+    }
+    return false;
+}
+
+// 条件请求: 客户端缓存的文件没有变化时返回 true, 回复 304
+// 有 If-None-Match 时忽略 If-Modified-Since
+static bool notModified(struct HttpRequest* request, struct FileCacheEntry* entry, const char* etag)
+{
+    const char* value = httpRequestGetHeader(request, "If-None-Match");
+    if (value != NULL)
+    {
+        return etagListMatch(value, etag);
+    }
+    value = httpRequestGetHeader(request, "If-Modified-Since");
+    if (value != NULL)
+    {
+        struct tm tm;
+        bzero(&tm, sizeof(tm));
+        if (strptime(value, "%a, %d %b %Y %H:%M:%S GMT", &tm) != NULL)
+        {
+            // 比当前时间还晚的日期是无效的(RFC 9110 13.1.3), 忽略这个请求头, 否则文件修改之后仍然返回 304
+            time_t since = timegm(&tm);
+            if (since != (time_t)-1 && since <= time(NULL))
+            {
+                return entry->st.st_mtime <= since;
+            }
+        }
+    }
+    return false;
+}
+
+// If-Range: 文件没有变化时才按照 Range 发送部分数据, 否则发送整个文件
+// 值可以是 ETag(强比较, 弱 ETag 不匹配) 或者 Last-Modified 中的日期
+static bool ifRangeMatch(const char* value, const char* etag, const char* lastModified)
+{
+    if (value == NULL)
+    {
+        return true;
+    }
+    if (value[0] == '"')
+    {
+        return strcmp(value, etag) == 0;
+    }
+    return strcmp(value, lastModified) == 0;
+}
+
+// 解析 Range 请求头: bytes=0-499, bytes=500-, bytes=-500, 多个范围之间用逗号分隔
+// 返回值: 可以满足的范围个数, 0 表示所有的范围都超出了文件的大小(416), -1 表示格式不对或者范围太多(忽略 Range)
+static int parseRange(const char* value, off_t size, struct ByteRange* ranges)
 {
-    if (strcasecmp(request->method, "get") != 0)
+    if (strncasecmp(value, "bytes=", 6) != 0)
     {
         return -1;
     }
+    int num = 0;
+    const char* p = value + 6;
+    while (true)
+    {
+        while (*p == ' ')
+        {
+            p++;
+        }
+        char* end = NULL;
+        long long first = -1, last = -1;
+        if (isdigit(*p))
+        {
+            first = strtoll(p, &end, 10);
+            p = end;
+        }
+        if (*p++ != '-')
+        {
+            return -1;
+        }
+        if (isdigit(*p))
+        {
+            last = strtoll(p, &end, 10);
+            p = end;
+        }
+        if (first == -1 && last == -1)
+        {
+            return -1;
+        }
+        if (first != -1 && last != -1 && last < first)
+        {
+            return -1;
+        }
+        off_t offset = 0, length = 0;
+        if (first == -1)
+        {
+            // 最后 last 个字节
+            offset = last < size ? size - last : 0;
+            length = size - offset;
+        }
+        else if (first < size)
+        {
+            offset = first;
+            length = (last == -1 || last >= size ? size - 1 : last) - first + 1;
+        }
+        // 超出文件大小的范围直接丢掉
+        if (length > 0)
+        {
+            if (num == MaxByteRanges)
+            {
+                return -1;
+            }
+            ranges[num].offset = offset;
+            ranges[num].length = length;
+            num++;
+        }
+        while (*p == ' ')
+        {
+            p++;
+        }
+        if (*p == '\0')
+        {
+            break;
+        }
+        if (*p++ != ',')
+        {
+            return -1;
+        }
+    }
+    return num;
+}
+
+// multipart/byteranges 中第 index 个数据段前面的分隔行和响应头, 返回字符串的长度
+static int rangePartHead(struct HttpResponse* response, int index, char* buf, int size)
+{
+    struct ByteRange* range = &response->ranges[index];
+    return snprintf(buf, size, "\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %ld-%ld/%ld\r\n\r\n",
+        response->rangeBoundary, response->rangeType, range->offset,
+        range->offset + range->length - 1, response->fileEntry->st.st_size);
+}
+
+// 范围请求的响应: 416 或者 206, 数据由 sendFile(一个范围) / sendRanges(多个范围) 发送
+static void setRangeResponse(struct HttpResponse* response, const char* type, const char* encoding, int num)
+{
+    static __thread unsigned int boundarySeq = 0;
+    off_t size = response->fileEntry->st.st_size;
+    char tmp[256] = { 0 };
+    if (num == 0)
+    {
+        response->statusCode = RangeNotSatisfiable;
+        strcpy(response->statusMsg, "Range Not Satisfiable");
+        sprintf(tmp, "bytes */%ld", size);
+        httpResponseAddHeader(response, "Content-Range", tmp);
+        httpResponseAddHeader(response, "Content-length", "0");
+        return;
+    }
+    response->statusCode = PartialContent;
+    strcpy(response->statusMsg, "Partial Content");
+    response->rangeNum = num;
+    off_t length = 0;
+    if (num == 1)
+    {
+        struct ByteRange* range = &response->ranges[0];
+        httpResponseAddHeader(response, "Content-type", type);
+        sprintf(tmp, "bytes %ld-%ld/%ld", range->offset, range->offset + range->length - 1, size);
+        httpResponseAddHeader(response, "Content-Range", tmp);
+        length = range->length;
+        response->sendDataFunc = sendFile;
+    }
+    else
+    {
+        // 多个范围: 每个数据段前面有自己的 Content-Type 和 Content-Range
+        response->rangeType = type;
+        sprintf(response->rangeBoundary, "%08lx%08x", (unsigned long)time(NULL), boundarySeq++);
+        for (int i = 0; i < num; ++i)
+        {
+            length += rangePartHead(response, i, tmp, sizeof(tmp)) + response->ranges[i].length;
+        }
+        length += sprintf(tmp, "\r\n--%s--\r\n", response->rangeBoundary);
+        sprintf(tmp, "multipart/byteranges; boundary=%s", response->rangeBoundary);
+        httpResponseAddHeader(response, "Content-type", tmp);
+        response->sendDataFunc = sendRanges;
+    }
+    sprintf(tmp, "%ld", length);
+    httpResponseAddHeader(response, "Content-length", tmp);
+    if (encoding != NULL)
+    {
+        httpResponseAddHeader(response, "Content-Encoding", encoding);
+    }
+}
+
+// 回复 404, 响应体是 404.html
+static void setNotFound(struct HttpResponse* response, struct FileCache* cache)
+{
+    // 文件不存在 -- 回复404
+    //sendHeadMsg(cfd, 404, "Not Found", getFileType(".html"), -1);
+    //sendFile("404.html", cfd);
+    strcpy(response->fileName, "404.html");
+    response->statusCode = NotFound;
+    strcpy(response->statusMsg, "Not Found");
+    // 响应头
+    httpResponseAddHeader(response, "Content-type", getFileType(".html"));
+    response->fileEntry = fileCacheLookup(cache, response->fileName);
+    if (response->fileEntry != NULL && fileCacheOpen(response->fileEntry) != -1)
+    {
+        char tmp[12] = { 0 };
+        sprintf(tmp, "%ld", response->fileEntry->st.st_size);
+        httpResponseAddHeader(response, "Content-length", tmp);
+    }
+    else
+    {
+        // 无法确定数据长度, 只能通过断开连接告诉客户端数据发送完毕
+        response->keepAlive = false;
+    }
+    response->sendDataFunc = sendFile;
+}
+
+// 不支持的请求方法: 标准的方法回复 405, 不认识的方法回复 501, 之后断开连接(请求体没有被读取)
+static void setMethodError(struct HttpResponse* response, const char* method)
+{
+    static const char* knownMethods[] = { "POST", "PUT", "DELETE", "PATCH", "OPTIONS", "TRACE", "CONNECT" };
+    response->statusCode = NotImplemented;
+    strcpy(response->statusMsg, "Not Implemented");
+    for (size_t i = 0; i < sizeof(knownMethods) / sizeof(knownMethods[0]); ++i)
+    {
+        if (strcasecmp(method, knownMethods[i]) == 0)
+        {
+            response->statusCode = MethodNotAllowed;
+            strcpy(response->statusMsg, "Method Not Allowed");
+            break;
+        }
+    }
+    httpResponseAddHeader(response, "Allow", "GET, HEAD");
+    httpResponseAddHeader(response, "Content-length", "0");
+    response->keepAlive = false;
+}
+
+// 处理基于get的http请求, HEAD 请求按照 get 请求处理, 由调用者去掉响应体
+bool processHttpRequest(struct HttpRequest* request, struct HttpResponse* response)
+{
+    if (strcasecmp(request->method, "get") != 0 && strcasecmp(request->method, "head") != 0)
+    {
+        setMethodError(response, request->method);
+        return false;
+    }
     decodeMsg(request->url, request->url);
     // 处理客户端请求的静态资源(目录或者文件)
     char* file = NULL;
@@ -239,20 +822,21 @@ bool processHttpRequest(struct HttpRequest* request, struct HttpResponse* respon
     {
         file = request->url + 1;
     }
-    // 获取文件属性
-    struct stat st;
-    int ret = stat(file, &st);
-    if (ret == -1)
-    {
-        // 文件不存在 -- 回复404
-        //sendHeadMsg(cfd, 404, "Not Found", getFileType(".html"), -1);
-        //sendFile("404.html", cfd);
-        strcpy(response->fileName, "404.html");
-        response->statusCode = NotFound;
-        strcpy(response->statusMsg, "Not Found");
-        // 响应头
-        httpResponseAddHeader(response, "Content-type", getFileType(".html"));
-        response->sendDataFunc = sendFile;
+    // 获取文件属性, 优先从当前线程的文件缓存中查找
+    struct FileCache* cache = fileCacheLocal();
+    struct FileCacheEntry* entry = NULL;
+    if (strlen(file) < sizeof(response->fileName))
+    {
+        entry = fileCacheLookup(cache, file);
+    }
+    // 文件不存在, 或者既不是目录也不是普通文件
+    if (entry == NULL || entry->error != 0 || (!S_ISDIR(entry->st.st_mode) && !S_ISREG(entry->st.st_mode)))
+    {
+        if (entry != NULL)
+        {
+            fileCacheRelease(entry);
+        }
+        setNotFound(response, cache);
         return 0;
     }
 
@@ -260,26 +844,131 @@ bool processHttpRequest(struct HttpRequest* request, struct HttpResponse* respon
     response->statusCode = OK;
     strcpy(response->statusMsg, "OK");
     // 判断文件类型
-    if (S_ISDIR(st.st_mode))
+    if (S_ISDIR(entry->st.st_mode))
     {
         // 把这个目录中的内容发送给客户端
         //sendHeadMsg(cfd, 200, "OK", getFileType(".html"), -1);
         //sendDir(file, cfd);
-        // 响应头
-        httpResponseAddHeader(response, "Content-type", getFileType(".html"));
-        response->sendDataFunc = sendDir;
+        if (fileCachePageCandidate(entry))
+        {
+            // 目录列表只生成一次, 目录没有变化时之后的请求直接发送缓存的页面
+            cacheDirPage(response, entry);
+        }
+        if (entry->content != NULL)
+        {
+            // 缓存的页面有 Content-length, 可以保持长连接, 和响应头一起通过一次 sendmsg 发送
+            response->fileEntry = entry;
+            response->cachedHead = true;
+            response->bodyData = entry->content + entry->headLength;
+            response->bodyLength = entry->bodyLength;
+        }
+        else
+        {
+            fileCacheRelease(entry);
+            // 响应头
+            httpResponseAddHeader(response, "Content-type", getFileType(".html"));
+            response->sendDataFunc = sendDir;
+            // 目录的数据长度事先不知道, 发送完毕之后需要断开连接
+            response->keepAlive = false;
+        }
     }
     else
     {
-        // 把文件的内容发送给客户端
-        //sendHeadMsg(cfd, 200, "OK", getFileType(file), st.st_size);
-        //sendFile(file, cfd);
-        // 响应头
-        char tmp[12] = { 0 };
-        sprintf(tmp, "%ld", st.st_size);
-        httpResponseAddHeader(response, "Content-type", getFileType(file));
-        httpResponseAddHeader(response, "Content-length", tmp);
-        response->sendDataFunc = sendFile;
+        // 根据 Accept-Encoding 选择预先压缩好的文件, 内容类型还是原文件的类型
+        const char* type = getFileType(file);
+        const char* encoding = NULL;
+        bool vary = false;
+        struct FileCacheEntry* encoded = findEncodedFile(cache, file, entry,
+            httpRequestGetHeader(request, "Accept-Encoding"), &encoding, &vary);
+        if (encoded != NULL)
+        {
+            fileCacheRelease(entry);
+            entry = encoded;
+        }
+        // 响应发送完毕之后释放缓存项的引用
+        response->fileEntry = entry;
+        char etag[64] = { 0 };
+        char lastModified[32] = { 0 };
+        fileValidators(entry, etag, sizeof(etag), lastModified, sizeof(lastModified));
+        if (notModified(request, entry, etag))
+        {
+            // 客户端缓存的文件仍然有效: 只回复验证器, 不需要打开文件
+            response->statusCode = NotModified;
+            strcpy(response->statusMsg, "Not Modified");
+            httpResponseAddHeader(response, "ETag", etag);
+            httpResponseAddHeader(response, "Last-Modified", lastModified);
+            if (vary)
+            {
+                httpResponseAddHeader(response, "Vary", "Accept-Encoding");
+            }
+            return false;
+        }
+        if (fileCacheOpen(entry) == -1)
+        {
+            // 没有权限之类的原因无法打开文件
+            fileCacheRelease(entry);
+            response->fileEntry = NULL;
+            setNotFound(response, cache);
+            return false;
+        }
+        // 范围请求
+        int rangeNum = -1;
+        const char* range = httpRequestGetHeader(request, "Range");
+        if (range != NULL && ifRangeMatch(httpRequestGetHeader(request, "If-Range"), etag, lastModified))
+        {
+            rangeNum = parseRange(range, entry->st.st_size, response->ranges);
+        }
+        if (rangeNum >= 0)
+        {
+            setRangeResponse(response, type, encoding, rangeNum);
+            if (rangeNum > 0)
+            {
+                httpResponseAddHeader(response, "ETag", etag);
+                httpResponseAddHeader(response, "Last-Modified", lastModified);
+            }
+        }
+        else if (entry->content != NULL && entry->encodedHead == (encoding != NULL))
+        {
+            // 热点文件: 状态行, 响应头和文件内容都在内存中, 和 Connection 响应头一起通过一次 sendmsg 发送
+            response->cachedHead = true;
+            response->bodyData = entry->content + entry->headLength;
+            response->bodyLength = entry->bodyLength;
+        }
+        else
+        {
+            // 把文件的内容发送给客户端
+            //sendHeadMsg(cfd, 200, "OK", getFileType(file), st.st_size);
+            //sendFile(file, cfd);
+            // 响应头
+            char tmp[12] = { 0 };
+            sprintf(tmp, "%ld", entry->st.st_size);
+            httpResponseAddHeader(response, "Content-type", type);
+            httpResponseAddHeader(response, "Content-length", tmp);
+            httpResponseAddHeader(response, "Accept-Ranges", "bytes");
+            httpResponseAddHeader(response, "ETag", etag);
+            httpResponseAddHeader(response, "Last-Modified", lastModified);
+            if (encoding != NULL)
+            {
+                httpResponseAddHeader(response, "Content-Encoding", encoding);
+            }
+            if (fileCacheHotCandidate(entry))
+            {
+                // 请求比较频繁的小文件: 把状态行, 响应头和文件内容放到内存中, 之后的请求直接使用
+                struct Buffer* head = bufferInit(512);
+                httpResponseAppendHead(response, head);
+                if (fileCacheSetContent(entry, head->data + head->readPos, bufferReadableSize(head)))
+                {
+                    entry->encodedHead = encoding != NULL;
+                }
+                bufferDestroy(head);
+            }
+            response->sendDataFunc = sendFile;
+        }
+        // 存在压缩版本时, 响应内容和 Accept-Encoding 有关, 告诉缓存服务器
+        if (vary)
+        {
+            httpResponseAddHeader(response, "Vary", "Accept-Encoding");
+        }
     }
 
     return false;
@@ -334,131 +1023,172 @@ void decodeMsg(char* to, char* from)
 const char* getFileType(const char* name)
 {
     // a.jpg a.mp4 a.html
-    // 自右向左查找‘.’字符, 如不存在返回NULL
+    // 自右向左查找‘.’字符, 如不存在返回NULL, 只查找文件名部分(目录名中的 '.' 不算)
     const char* dot = strrchr(name, '.');
-    if (dot == NULL)
-        return "text/plain; charset=utf-8";	// 纯文本
-    if (strcmp(dot, ".html") == 0 || strcmp(dot, ".htm") == 0)
-        return "text/html; charset=utf-8";
-    if (strcmp(dot, ".jpg") == 0 || strcmp(dot, ".jpeg") == 0)
-        return "image/jpeg";
-    if (strcmp(dot, ".gif") == 0)
-        return "image/gif";
-    if (strcmp(dot, ".png") == 0)
-        return "image/png";
-    if (strcmp(dot, ".css") == 0)
-        return "text/css";
-    if (strcmp(dot, ".au") == 0)
-        return "audio/basic";
-    if (strcmp(dot, ".wav") == 0)
-        return "audio/wav";
-    if (strcmp(dot, ".avi") == 0)
-        return "video/x-msvideo";
-    if (strcmp(dot, ".mov") == 0 || strcmp(dot, ".qt") == 0)
-        return "video/quicktime";
-    if (strcmp(dot, ".mpeg") == 0 || strcmp(dot, ".mpe") == 0)
-        return "video/mpeg";
-    if (strcmp(dot, ".vrml") == 0 || strcmp(dot, ".wrl") == 0)
-        return "model/vrml";
-    if (strcmp(dot, ".midi") == 0 || strcmp(dot, ".mid") == 0)
-        return "audio/midi";
-    if (strcmp(dot, ".mp3") == 0)
-        return "audio/mpeg";
-    if (strcmp(dot, ".ogg") == 0)
-        return "application/ogg";
-    if (strcmp(dot, ".pac") == 0)
-        return "application/x-ns-proxy-autoconfig";
-
-    return "text/plain; charset=utf-8";
-}
-
-void sendDir(const char* dirName, struct Buffer* sendBuf, int cfd)
-{
-    char buf[4096] = { 0 };
-    sprintf(buf, "<html><head><title>%s</title></head><body><table>", dirName);
-    struct dirent** namelist;
-    int num = scandir(dirName, &namelist, NULL, alphasort);
+    const char* slash = strrchr(name, '/');
+    const char* type = NULL;
+    if (dot != NULL && (slash == NULL || dot > slash))
+    {
+        type = mimeTypeLookup(dot + 1);
+    }
+    return type != NULL ? type : "text/plain; charset=utf-8";	// 纯文本
+}
+
+// 目录列表中的一行: 文件名(链接)和文件大小
+static void appendDirRow(struct Buffer* sendBuf, const char* dirName, const char* name)
+{
+    struct stat st;
+    char subPath[1024] = { 0 };
+    snprintf(subPath, sizeof(subPath), "%s/%s", dirName, name);
+    if (stat(subPath, &st) == -1)
+    {
+        st.st_mode = 0;
+        st.st_size = 0;
+    }
+    // a标签 <a href="">name</a>, 目录的链接以 / 结尾
+    char buf[1024];
+    int length = snprintf(buf, sizeof(buf), "<tr><td><a href=\"%s%s\">%s</a></td><td>%ld</td></tr>",
+        name, S_ISDIR(st.st_mode) ? "/" : "", name, st.st_size);
+    bufferAppendData(sendBuf, buf, length < (int)sizeof(buf) ? length : (int)sizeof(buf) - 1);
+}
+
+static void appendDirHead(struct Buffer* sendBuf, const char* dirName)
+{
+    char buf[1024];
+    int length = snprintf(buf, sizeof(buf), "<html><head><title>%s</title></head><body><table>", dirName);
+    bufferAppendData(sendBuf, buf, length < (int)sizeof(buf) ? length : (int)sizeof(buf) - 1);
+}
+
+static const char dirTail[] = "</table></body></html>";
+
+// 生成整个目录列表页面并和序列化好的响应头一起保存到目录的缓存项中
+static void cacheDirPage(struct HttpResponse* response, struct FileCacheEntry* entry)
+{
+    const char* dirName = response->fileName;
+    struct dirent** list = NULL;
+    int num = scandir(dirName, &list, NULL, alphasort);
+    if (num < 0)
+    {
+        return;
+    }
+    struct Buffer* page = bufferInit(4096);
+    appendDirHead(page, dirName);
     for (int i = 0; i < num; ++i)
     {
-        // 取出文件名 namelist 指向的是一个指针数组 struct dirent* tmp[]
-        char* name = namelist[i]->d_name;
-        struct stat st;
-        char subPath[1024] = { 0 };
-        sprintf(subPath, "%s/%s", dirName, name);
-        stat(subPath, &st);
-        if (S_ISDIR(st.st_mode))
-        {
-            // a标签 <a href="">name</a>
-            sprintf(buf + strlen(buf),
-                "<tr><td><a href=\"%s/\">%s</a></td><td>%ld</td></tr>",
-                name, name, st.st_size);
-        }
-        else
+        appendDirRow(page, dirName, list[i]->d_name);
+        free(list[i]);
+    }
+    free(list);
+    bufferAppendData(page, dirTail, sizeof(dirTail) - 1);
+    // 响应头: 状态行, Content-type 和 Content-length, 只用来序列化, 之后从 response 中去掉
+    int headerNum = response->headerNum;
+    char tmp[12] = { 0 };
+    sprintf(tmp, "%d", bufferReadableSize(page));
+    httpResponseAddHeader(response, "Content-type", getFileType(".html"));
+    httpResponseAddHeader(response, "Content-length", tmp);
+    struct Buffer* head = bufferInit(512);
+    httpResponseAppendHead(response, head);
+    response->headerNum = headerNum;
+    fileCacheSetPage(entry, head->data + head->readPos, bufferReadableSize(head),
+        page->data + page->readPos, bufferReadableSize(page));
+    bufferDestroy(head);
+    bufferDestroy(page);
+}
+
+int sendDir(struct HttpResponse* response, struct Buffer* sendBuf, int size)
+{
+    const char* dirName = response->fileName;
+    int start = bufferReadableSize(sendBuf);
+    if (response->dirNum < 0)
+    {
+        // 第一次调用: 读取目录中的文件列表, 生成页面的头部
+        response->dirNum = scandir(dirName, &response->dirList, NULL, alphasort);
+        if (response->dirNum < 0)
         {
-            sprintf(buf + strlen(buf),
-                "<tr><td><a href=\"%s\">%s</a></td><td>%ld</td></tr>",
-                name, name, st.st_size);
+            response->dirList = NULL;
+            response->dirNum = 0;
         }
-        // send(cfd, buf, strlen(buf), 0);
-        bufferAppendString(sendBuf, buf);
-#ifndef MSG_SEND_AUTO
-        bufferSendData(sendBuf, cfd);
-#endif
-        memset(buf, 0, sizeof(buf));
-        free(namelist[i]);
+        appendDirHead(sendBuf, dirName);
     }
-    sprintf(buf, "</table></body></html>");
-    // send(cfd, buf, strlen(buf), 0);
-    bufferAppendString(sendBuf, buf);
-#ifndef MSG_SEND_AUTO
-    bufferSendData(sendBuf, cfd);
-#endif
-    free(namelist);
+    // 每次最多生成 size 个字节, 剩下的等写缓冲区中的数据发送出去之后再生成
+    while (response->dirIndex < response->dirNum && bufferReadableSize(sendBuf) - start < size)
+    {
+        // 取出文件名 namelist 指向的是一个指针数组 struct dirent* tmp[]
+        struct dirent* entry = response->dirList[response->dirIndex++];
+        appendDirRow(sendBuf, dirName, entry->d_name);
+        free(entry);
+    }
+    if (response->dirIndex < response->dirNum)
+    {
+        return 1;
+    }
+    bufferAppendData(sendBuf, dirTail, sizeof(dirTail) - 1);
+    return 0;
 }
 
+// 发送文件中的一段数据: 热点文件直接发送内存中的内容, 否则使用缓存的文件描述符通过 sendfile 发送
+static void setFileBody(struct HttpResponse* response, off_t offset, off_t length)
+{
+    struct FileCacheEntry* entry = response->fileEntry;
+    if (entry->content != NULL)
+    {
+        response->bodyData = entry->content + entry->headLength + offset;
+        response->bodyLength = length;
+    }
+    else if (entry->fd != -1)
+    {
+        httpResponseSetFile(response, entry->fd, offset, length);
+    }
+}
 
-void sendFile(const char* fileName, struct Buffer* sendBuf, int cfd)
+int sendFile(struct HttpResponse* response, struct Buffer* sendBuf, int size)
 {
-    // 1. 打开文件
-    int fd = open(fileName, O_RDONLY);
-    assert(fd > 0);
-#if 1
-    while (1)
-    {
-        char buf[1024];
-        int len = read(fd, buf, sizeof buf);
-        if (len > 0)
-        {
-            // send(cfd, buf, len, 0);
-            bufferAppendData(sendBuf, buf, len);
-#ifndef MSG_SEND_AUTO
-            bufferSendData(sendBuf, cfd);
-#endif
-        }
-        else if (len == 0)
+    // 文件内容不经过 sendBuf, 由连接直接发送
+    (void)sendBuf;
+    (void)size;
+    struct FileCacheEntry* entry = response->fileEntry;
+    if (entry != NULL)
+    {
+        // 文件缓存中已经打开了文件, 直接使用缓存的文件描述符和文件大小, 范围请求只发送请求的那一段
+        if (response->rangeNum == 1)
         {
-            break;
+            setFileBody(response, response->ranges[0].offset, response->ranges[0].length);
         }
         else
         {
-            close(fd);
-            perror("read");
+            setFileBody(response, 0, entry->st.st_size);
         }
+        return 0;
     }
-#else
-    off_t offset = 0;
-    int size = lseek(fd, 0, SEEK_END);
-    lseek(fd, 0, SEEK_SET);
-    while (offset < size)
+    // 1. 打开文件
+    int fd = open(response->fileName, O_RDONLY);
+    if (fd == -1)
     {
-        int ret = sendfile(cfd, fd, &offset, size - offset);
-        printf("ret value: %d\n", ret);
-        if (ret == -1 && errno == EAGAIN)
-        {
-            printf("没数据...\n");
-        }
+        perror("open");
+        return 0;
     }
-#endif
-    close(fd);
+    // 2. 只记录文件的位置和长度, 文件内容由连接通过 sendfile 直接从内核发送到套接字,
+    //    不再经过用户态的 read + bufferAppendData 两次拷贝
+    struct stat st;
+    fstat(fd, &st);
+    httpResponseSetFile(response, fd, 0, st.st_size);
+    return 0;
 }
 
+int sendRanges(struct HttpResponse* response, struct Buffer* sendBuf, int size)
+{
+    (void)size;
+    char buf[256] = { 0 };
+    if (response->rangeIndex < response->rangeNum)
+    {
+        // 每次生成一个数据段: 分隔行和响应头放到写缓冲区中, 数据段在它们之后发送
+        int index = response->rangeIndex++;
+        rangePartHead(response, index, buf, sizeof(buf));
+        bufferAppendString(sendBuf, buf);
+        setFileBody(response, response->ranges[index].offset, response->ranges[index].length);
+        return 1;
+    }
+    sprintf(buf, "\r\n--%s--\r\n", response->rangeBoundary);
+    bufferAppendString(sendBuf, buf);
+    return 0;
+}
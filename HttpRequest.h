@@ -2,12 +2,16 @@
 #include "Buffer.h"
 #include <stdbool.h>
 #include "HttpResponse.h"
+#include "DelimIndex.h"
 
 // 请求头键值对
 struct RequestHeader
 {
     char* key;
     char* value;
+    // 零拷贝模式下键值在读缓冲区中的位置
+    struct BufferSlice keySlice;
+    struct BufferSlice valueSlice;
 };
 
 // 当前的解析状态
@@ -16,7 +20,8 @@ enum HttpRequestState
     ParseReqLine,
     ParseReqHeaders,
     ParseReqBody,
-    ParseReqDone
+    ParseReqDone,
+    ParseReqError
 };
 // 定义http请求结构体
 struct HttpRequest
@@ -27,6 +32,17 @@ struct HttpRequest
     struct RequestHeader* reqHeaders;
     int reqHeadersNum;
     enum HttpRequestState curState;
+    // 零拷贝模式: 解析时只记录各个字段在读缓冲区中的位置, 不再申请内存拷贝字符串,
+    // 请求解析完毕之后 method/url/version/请求头 直接指向读缓冲区中的数据
+    bool zeroCopy;
+    bool ownStrings;            // 字符串是否是单独申请的内存(需要释放)
+    struct Buffer* readBuf;     // 正在解析的读缓冲区, 解析期间被固定
+    struct BufferSlice methodSlice;
+    struct BufferSlice urlSlice;
+    struct BufferSlice versionSlice;
+    // 读缓冲区中分隔符的位置, 每个字节只扫描一次, 流水线中后面的请求继续使用
+    struct DelimIndex delims;
+    int delimBase;              // 上一个请求处理完时读缓冲区的 readPos, 用来发现缓冲区整理过内存
 };
 
 // 初始化
@@ -35,17 +51,23 @@ struct HttpRequest* httpRequestInit();
 void httpRequestReset(struct HttpRequest* req);
 void httpRequestResetEx(struct HttpRequest* req);
 void httpRequestDestroy(struct HttpRequest* req);
+// 设置零拷贝解析模式, 需要在解析请求之前设置
+void httpRequestSetZeroCopy(struct HttpRequest* req, bool zeroCopy);
+// 零拷贝模式下把解析出的字符串拷贝一份, 之后就不再依赖读缓冲区, 只能在请求解析完毕之后调用
+void httpRequestMaterialize(struct HttpRequest* req);
 // 获取处理状态
 enum HttpRequestState httpRequestState(struct HttpRequest* request);
 // 添加请求头
 void httpRequestAddHeader(struct HttpRequest* request, const char* key, const char* value);
 // 根据key得到请求头的value
 char* httpRequestGetHeader(struct HttpRequest* request, const char* key);
+// 根据协议版本和 Connection 请求头判断客户端是否希望保持长连接
+bool httpRequestKeepAlive(struct HttpRequest* request);
 // 解析请求行
 bool parseHttpRequestLine(struct HttpRequest* request, struct Buffer* readBuf);
 // 解析请求头
 bool parseHttpRequestHeader(struct HttpRequest* request, struct Buffer* readBuf);
-// 解析http请求协议
+// 解析http请求协议, 返回 false 时通过 httpRequestState 区分数据不完整和格式错误
 bool parseHttpRequest(struct HttpRequest* request, struct Buffer* readBuf,
     struct HttpResponse* response, struct Buffer* sendBuf, int socket);
 // 处理http请求协议
@@ -53,5 +75,9 @@ bool processHttpRequest(struct HttpRequest* request, struct HttpResponse* respon
 // 解码字符串
 void decodeMsg(char* to, char* from);
 const char* getFileType(const char* name);
-void sendDir(const char* dirName, struct Buffer* sendBuf, int cfd);
-void sendFile(const char* fileName, struct Buffer* sendBuf, int cfd);
\ No newline at end of file
+// 发送目录: 每次调用生成目录列表页面中的一部分
+int sendDir(struct HttpResponse* response, struct Buffer* sendBuf, int size);
+// 发送文件: 打开文件并记录到 response 中, 由连接使用 sendfile 零拷贝发送
+int sendFile(struct HttpResponse* response, struct Buffer* sendBuf, int size);
+// 发送多个范围(multipart/byteranges): 每次生成一个数据段的分隔行和响应头, 数据段由连接发送
+int sendRanges(struct HttpResponse* response, struct Buffer* sendBuf, int size);
\ No newline at end of file
@@ -1,15 +1,35 @@
 #pragma once
 #include "Buffer.h"
+#include <stdbool.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include "FileCache.h"
+#include "OutChain.h"
 
 // 定义状态码枚举
 enum HttpStatusCode
 {
     Unknown,
     OK = 200,
+    PartialContent = 206,
     MovedPermanently = 301,
     MovedTemporarily = 302,
+    NotModified = 304,
     BadRequest = 400,
-    NotFound = 404
+    NotFound = 404,
+    MethodNotAllowed = 405,
+    RangeNotSatisfiable = 416,
+    NotImplemented = 501
+};
+
+// 一个请求最多处理的范围个数, 超过之后忽略 Range 请求头, 发送整个文件
+#define MaxByteRanges 16
+
+// 范围请求(Range)中的一段数据: 在文件中的偏移量和长度
+struct ByteRange
+{
+    off_t offset;
+    off_t length;
 };
 
 // 定义响应的结构体
@@ -17,10 +37,23 @@ struct ResponseHeader
 {
     char key[32];
     char value[128];
+    // 添加时记录长度, 序列化时不需要再 strlen
+    int keyLength;
+    int valueLength;
 };
 
-// 定义一个函数指针, 用来组织要回复给客户端的数据块
-typedef void (*responseBody)(const char* fileName, struct Buffer* sendBuf, int socket);
+// 服务器名称, 作为固定的响应头放在每个响应中
+#define ServerName "Reactor"
+
+struct HttpResponse;
+// 定义一个函数指针, 用来按需生成要回复给客户端的数据块(拉取模式):
+// 写缓冲区中的数据发送出去之后由连接调用, 每次向 sendBuf 追加大约 size 个字节,
+// 也可以通过 httpResponseSetFile 设置一段文件, 文件在追加的数据之后发送
+// 返回值: 1 还有数据需要生成, 0 数据已经全部生成
+typedef int (*responseBody)(struct HttpResponse* response, struct Buffer* sendBuf, int size);
+
+// 小于这个大小的文件直接读到内存中, 和其他数据一起通过一次 sendmsg 发送
+#define InlineFileMax 16384
 
 // 定义结构体
 struct HttpResponse
@@ -33,13 +66,46 @@ struct HttpResponse
     struct ResponseHeader* headers;
     int headerNum;
     responseBody sendDataFunc;
+    // 响应体对应的文件: 由连接通过 sendfile 从 fileOffset 开始发送 fileLength 个字节
+    int fileFd;
+    off_t fileOffset;
+    off_t fileLength;
+    // 响应对应的文件缓存项(持有一个引用), 文件描述符属于缓存, 不由 response 关闭
+    struct FileCacheEntry* fileEntry;
+    // 热点文件: 状态行和固定的响应头使用缓存项中序列化好的数据, 响应体直接从缓存项的内存中发送
+    bool cachedHead;
+    const char* bodyData;
+    int bodyLength;
+    // 范围请求: 需要发送的数据段, rangeNum 为 0 表示发送整个文件, 多个数据段使用 multipart/byteranges 发送
+    struct ByteRange ranges[MaxByteRanges];
+    int rangeNum;
+    int rangeIndex;          // 下一个要发送的数据段
+    const char* rangeType;   // 每个数据段的 Content-Type
+    char rangeBoundary[32];  // multipart 的分隔字符串
+    // 目录列表: scandir 的结果以及下一个要生成的目录项, dirNum 为 -1 表示还没有读取目录
+    struct dirent** dirList;
+    int dirNum;
+    int dirIndex;
+    // 本次响应之后是否保持长连接
+    bool keepAlive;
 };
 
 // 初始化
 struct HttpResponse* httpResponseInit();
+// 重置, 长连接中处理下一个请求之前调用
+void httpResponseReset(struct HttpResponse* response);
 // 销毁
 void httpResponseDestroy(struct HttpResponse* response);
+// 设置响应体对应的文件, 文件描述符由 response 负责关闭(文件缓存项中的文件描述符除外)
+void httpResponseSetFile(struct HttpResponse* response, int fd, off_t offset, off_t length);
+// 把 sendBuf 中已经生成的数据和响应体依次挂到输出链上: 热点文件的内容借用缓存项的内存,
+// 小文件读到输出链的内存中(流水线中多个响应可以一次发送), 大文件使用 sendfile, 需要生成的数据继续生成
+// 输出链中自己拥有的内存超过 limit 时停止并返回 false, 等数据发送出去之后再继续, 全部挂到输出链上返回 true
+bool httpResponseChainBody(struct HttpResponse* response, struct Buffer* sendBuf, struct OutChain* chain, int limit);
 // 添加响应头
 void httpResponseAddHeader(struct HttpResponse*, const char* key, const char* value);
-// 组织http响应数据
+// 把状态行和响应头(不包括 Date 和结尾的空行)序列化到 sendBuf 中, 常用的状态行直接查表
+void httpResponseAppendHead(struct HttpResponse* response, struct Buffer* sendBuf);
+// 组织http响应数据(状态行和响应头), 响应体由连接通过 sendDataFunc 按需拉取
+// Date 响应头由每个事件循环的线程缓存, 每秒最多重新格式化一次
 void httpResponsePrepareMsg(struct HttpResponse* response, struct Buffer* sendBuf, int socket);
\ No newline at end of file
@@ -3,63 +3,284 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
+#include "MemPool.h"
+#include <stdint.h>
+#include <time.h>
 
 #define ResHeaderSize 16
 struct HttpResponse* httpResponseInit()
 {
-    struct HttpResponse* response = (struct HttpResponse*)malloc(sizeof(struct HttpResponse));
-    response->headerNum = 0;
+    struct HttpResponse* response = (struct HttpResponse*)memPoolAlloc(sizeof(struct HttpResponse));
     int size = sizeof(struct ResponseHeader) * ResHeaderSize;
-    response->headers = (struct ResponseHeader*)malloc(size);
+    response->headers = (struct ResponseHeader*)memPoolAlloc(size);
+    response->fileFd = -1;
+    response->fileEntry = NULL;
+    response->bodyData = NULL;
+    response->dirList = NULL;
+    response->dirNum = -1;
+    httpResponseReset(response);
+
+    return response;
+}
+
+void httpResponseReset(struct HttpResponse* response)
+{
+    response->headerNum = 0;
     response->statusCode = Unknown;
     // 初始化数组
-    bzero(response->headers, size);
+    bzero(response->headers, sizeof(struct ResponseHeader) * ResHeaderSize);
     bzero(response->statusMsg, sizeof(response->statusMsg));
     bzero(response->fileName, sizeof(response->fileName));
     // 函数指针
     response->sendDataFunc = NULL;
+    response->keepAlive = false;
+    response->cachedHead = false;
+    response->bodyData = NULL;
+    response->bodyLength = 0;
+    response->rangeNum = 0;
+    response->rangeIndex = 0;
+    // 关闭响应体对应的文件, 释放文件缓存项和还没有生成的目录项
+    httpResponseSetFile(response, -1, 0, 0);
+    if (response->fileEntry != NULL)
+    {
+        fileCacheRelease(response->fileEntry);
+        response->fileEntry = NULL;
+    }
+    if (response->dirList != NULL)
+    {
+        for (int i = response->dirIndex; i < response->dirNum; ++i)
+        {
+            free(response->dirList[i]);
+        }
+        free(response->dirList);
+        response->dirList = NULL;
+    }
+    response->dirNum = -1;
+    response->dirIndex = 0;
+}
 
-    return response;
+void httpResponseSetFile(struct HttpResponse* response, int fd, off_t offset, off_t length)
+{
+    bool cachedFd = response->fileEntry != NULL && response->fileFd == response->fileEntry->fd;
+    if (response->fileFd != -1 && response->fileFd != fd && !cachedFd)
+    {
+        close(response->fileFd);
+    }
+    response->fileFd = fd;
+    response->fileOffset = offset;
+    response->fileLength = length;
+}
+
+// 输出链中的数据发送完毕之后释放缓存项的引用
+static void releaseEntry(void* arg)
+{
+    fileCacheRelease((struct FileCacheEntry*)arg);
+}
+
+// 输出链中的文件发送完毕之后关闭文件
+static void releaseFd(void* arg)
+{
+    close((int)(intptr_t)arg);
+}
+
+bool httpResponseChainBody(struct HttpResponse* response, struct Buffer* sendBuf, struct OutChain* chain, int limit)
+{
+    struct FileCacheEntry* entry = response->fileEntry;
+    while (true)
+    {
+        // 1. 已经生成的数据(状态行, 响应头, 目录列表等), 在响应体之前发送
+        outChainAppendBuffer(chain, sendBuf);
+        // 2. 热点文件缓存中的响应体, 输出链持有缓存项的一个引用
+        if (response->bodyLength > 0)
+        {
+            fileCacheRetain(entry);
+            outChainAppendRef(chain, response->bodyData, response->bodyLength, releaseEntry, entry);
+            response->bodyData += response->bodyLength;
+            response->bodyLength = 0;
+        }
+        // 3. 文件
+        if (response->fileLength > 0)
+        {
+            // 文件长度可能超过 int, 只有确定要拷贝到内存中时才转换
+            bool inlined = false;
+            if (response->fileLength <= InlineFileMax && chain->ownedBytes + response->fileLength <= limit)
+            {
+                int length = (int)response->fileLength;
+                ssize_t count = pread(response->fileFd, outChainReserve(chain, length), length, response->fileOffset);
+                inlined = count == length;
+                outChainCommit(chain, inlined ? length : 0);
+            }
+            if (!inlined)
+            {
+                // 大文件(或者读取失败)使用 sendfile 发送, 缓存的文件描述符由缓存项负责关闭
+                bool cachedFd = entry != NULL && response->fileFd == entry->fd;
+                if (cachedFd)
+                {
+                    fileCacheRetain(entry);
+                }
+                outChainAppendFile(chain, response->fileFd, response->fileOffset, response->fileLength,
+                    cachedFd ? releaseEntry : releaseFd, cachedFd ? (void*)entry : (void*)(intptr_t)response->fileFd);
+            }
+            else if (entry == NULL || response->fileFd != entry->fd)
+            {
+                close(response->fileFd);
+            }
+            // 文件已经交给输出链了, response 不再关闭它
+            response->fileFd = -1;
+            response->fileOffset = response->fileLength = 0;
+        }
+        // 4. 继续生成数据
+        if (response->sendDataFunc == NULL)
+        {
+            return true;
+        }
+        if (chain->ownedBytes >= limit)
+        {
+            return false;
+        }
+        if (response->sendDataFunc(response, sendBuf, limit - chain->ownedBytes) == 0)
+        {
+            response->sendDataFunc = NULL;
+        }
+    }
 }
 
 void httpResponseDestroy(struct HttpResponse* response)
 {
     if (response != NULL)
     {
-        free(response->headers);
-        free(response);
+        httpResponseReset(response);
+        memPoolFree(response->headers, sizeof(struct ResponseHeader) * ResHeaderSize);
+        memPoolFree(response, sizeof(struct HttpResponse));
     }
 }
 
 void httpResponseAddHeader(struct HttpResponse* response, const char* key, const char* value)
 {
-    if (response == NULL || key == NULL || value == NULL)
+    if (response == NULL || key == NULL || value == NULL || response->headerNum >= ResHeaderSize)
     {
         return;
     }
-    strcpy(response->headers[response->headerNum].key, key);
-    strcpy(response->headers[response->headerNum].value, value);
+    struct ResponseHeader* header = &response->headers[response->headerNum];
+    int keyLength = strlen(key);
+    int valueLength = strlen(value);
+    // 太长的部分截断, 不能超出数组
+    header->keyLength = keyLength < (int)sizeof(header->key) ? keyLength : (int)sizeof(header->key) - 1;
+    header->valueLength = valueLength < (int)sizeof(header->value) ? valueLength : (int)sizeof(header->value) - 1;
+    memcpy(header->key, key, header->keyLength);
+    header->key[header->keyLength] = '\0';
+    memcpy(header->value, value, header->valueLength);
+    header->value[header->valueLength] = '\0';
     response->headerNum++;
 }
 
-void httpResponsePrepareMsg(struct HttpResponse* response, struct Buffer* sendBuf, int socket)
+// 常用的状态行, 不需要每次格式化
+#define StatusLine(code, msg) { code, "HTTP/1.1 " #code " " msg "\r\n", sizeof("HTTP/1.1 " #code " " msg "\r\n") - 1 }
+static const struct
+{
+    int code;
+    const char* line;
+    int length;
+} statusLines[] = {
+    StatusLine(200, "OK"),
+    StatusLine(206, "Partial Content"),
+    StatusLine(301, "Moved Permanently"),
+    StatusLine(302, "Found"),
+    StatusLine(304, "Not Modified"),
+    StatusLine(400, "Bad Request"),
+    StatusLine(404, "Not Found"),
+    StatusLine(405, "Method Not Allowed"),
+    StatusLine(416, "Range Not Satisfiable"),
+    StatusLine(501, "Not Implemented"),
+};
+
+// 每个事件循环的线程缓存格式化好的 Date 响应头, 时间(秒)变化之后才重新格式化
+static __thread time_t dateSecond = 0;
+static __thread char dateLine[64];
+static __thread int dateLength = 0;
+
+// 追加一行响应头, 一次预留足够的空间, 直接拷贝
+static void appendHeaderLine(struct Buffer* sendBuf, const char* key, int keyLength, const char* value, int valueLength)
+{
+    int size = keyLength + valueLength + 4;
+    bufferExtendRoom(sendBuf, size);
+    char* p = sendBuf->data + sendBuf->writePos;
+    memcpy(p, key, keyLength);
+    p += keyLength;
+    *p++ = ':';
+    *p++ = ' ';
+    memcpy(p, value, valueLength);
+    p += valueLength;
+    *p++ = '\r';
+    *p++ = '\n';
+    sendBuf->writePos += size;
+}
+
+static void appendHeaders(struct HttpResponse* response, struct Buffer* sendBuf)
 {
-    // 状态行
-    char tmp[1024] = { 0 };
-    sprintf(tmp, "HTTP/1.1 %d %s\r\n", response->statusCode, response->statusMsg);
-    bufferAppendString(sendBuf, tmp);
-    // 响应头
     for (int i = 0; i < response->headerNum; ++i)
     {
-        sprintf(tmp, "%s: %s\r\n", response->headers[i].key, response->headers[i].value);
-        bufferAppendString(sendBuf, tmp);
+        struct ResponseHeader* header = &response->headers[i];
+        appendHeaderLine(sendBuf, header->key, header->keyLength, header->value, header->valueLength);
     }
-    // 空行
-    bufferAppendString(sendBuf, "\r\n");
-#ifndef MSG_SEND_AUTO
-    bufferSendData(sendBuf, socket);
-#endif
+}
 
-    // 回复的数据
-    response->sendDataFunc(response->fileName, sendBuf, socket);
+static void appendDate(struct Buffer* sendBuf)
+{
+    time_t now = time(NULL);
+    if (now != dateSecond)
+    {
+        struct tm tm;
+        gmtime_r(&now, &tm);
+        dateLength = strftime(dateLine, sizeof(dateLine), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+        dateSecond = now;
+    }
+    bufferAppendData(sendBuf, dateLine, dateLength);
+}
+
+void httpResponseAppendHead(struct HttpResponse* response, struct Buffer* sendBuf)
+{
+    // 状态行: 常用的状态码直接使用表中的字符串
+    int i = 0;
+    int num = sizeof(statusLines) / sizeof(statusLines[0]);
+    while (i < num && statusLines[i].code != (int)response->statusCode)
+    {
+        ++i;
+    }
+    if (i < num)
+    {
+        bufferAppendData(sendBuf, statusLines[i].line, statusLines[i].length);
+    }
+    else
+    {
+        char tmp[160] = { 0 };
+        int length = snprintf(tmp, sizeof(tmp), "HTTP/1.1 %d %s\r\n", response->statusCode, response->statusMsg);
+        bufferAppendData(sendBuf, tmp, length < (int)sizeof(tmp) ? length : (int)sizeof(tmp) - 1);
+    }
+    // 固定的响应头
+    appendHeaderLine(sendBuf, "Server", sizeof("Server") - 1, ServerName, sizeof(ServerName) - 1);
+    // 响应头
+    appendHeaders(response, sendBuf);
+}
+
+void httpResponsePrepareMsg(struct HttpResponse* response, struct Buffer* sendBuf, int socket)
+{
+    // 数据由连接发送, 这里不再直接写套接字
+    (void)socket;
+    if (response->cachedHead)
+    {
+        // 热点文件: 状态行和固定的响应头已经序列化好了, 只需要追加 Connection 等动态的响应头
+        struct FileCacheEntry* entry = response->fileEntry;
+        bufferAppendData(sendBuf, entry->content, entry->headLength);
+        appendHeaders(response, sendBuf);
+    }
+    else
+    {
+        httpResponseAppendHead(response, sendBuf);
+    }
+    appendDate(sendBuf);
+    // 空行
+    bufferAppendData(sendBuf, "\r\n", 2);
+    // 数据由连接统一发送, 流水线中多个请求的响应可以合并成一次发送
 }
@@ -0,0 +1,580 @@
+#include "Dispatcher.h"
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#define Max 1024                    // 提交队列的大小
+#define RemoveTag ((uint64_t)-1)    // POLL_REMOVE 和取消请求自身的完成事件, 直接忽略
+#define MaxFd (1 << 24)             // user_data 中 fd 占低 24 位
+
+// 请求的类型, 放在 user_data 的 24-31 位: [版本号:32][类型:8][fd:24]
+enum UringOp
+{
+    OpPoll,   // poll 请求(就绪模式), 带版本号
+    OpAccept, // 完成模式的 accept, 不带版本号(修改事件不影响它)
+    OpRecv,
+    OpSend,
+    OpAcceptPoll // accept 因为文件描述符耗尽失败之后, 等待监听队列中有连接的 poll 请求
+};
+
+// 每个 fd 在 io_uring 中的注册状态
+struct UringFdState
+{
+    unsigned gen; // 版本号, 每次修改或删除都加一, 用来过滤已经失效的 poll 请求产生的完成事件
+    bool armed;   // 内核中是否有这个 fd 还没有完成的 poll 请求
+    // 完成模式: 还没有完成的操作, 内核可能还在使用 channel 提供的缓冲区
+    bool accepting;
+    bool receiving;
+    bool sending;
+    // 已经删除但还有操作没有完成的 channel, 所有操作完成(或者被取消)之后再释放
+    struct Channel *removed;
+};
+
+// 定义 IoUringData 结构体, 保存 io_uring 相关数据
+struct IoUringData
+{
+    int ringFd;
+    // 提交队列(sq), 与内核共享的内存
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned sqEntries;
+    struct io_uring_sqe *sqes;
+    // 完成队列(cq), 与内核共享的内存
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+    // mmap 得到的内存, 释放时使用
+    void *sqPtr;
+    void *cqPtr;
+    size_t sqSize;
+    size_t cqSize;
+    size_t sqesSize;
+    // 以 fd 为下标的注册状态
+    struct UringFdState *fds;
+    int size;
+    // 内核是否支持 multishot accept(5.19), 不支持时每次 accept 完成之后重新提交
+    bool multishotAccept;
+};
+
+static void *uringInit();
+static int uringAdd(struct Channel *channel, struct EventLoop *evLoop);
+static int uringRemove(struct Channel *channel, struct EventLoop *evLoop);
+static int uringModify(struct Channel *channel, struct EventLoop *evLoop);
+static int uringDispatch(struct EventLoop *evLoop, int timeout); // 单位: ms
+static int uringClear(struct EventLoop *evLoop);
+static int uringAccept(struct Channel *channel, struct EventLoop *evLoop);
+static int uringRecv(struct Channel *channel, struct EventLoop *evLoop, void *buf, int size);
+static int uringSendMsg(struct Channel *channel, struct EventLoop *evLoop, struct msghdr *msg);
+
+// 就绪模式: 只用 poll 请求检测事件, 读写仍然由回调函数调用系统调用完成
+struct Dispatcher IoUringDispatcher = {
+    uringInit,
+    uringAdd,
+    uringRemove,
+    uringModify,
+    uringDispatch,
+    uringClear,
+    NULL, // 不支持完成模式
+    NULL,
+    NULL};
+
+// 完成模式: accept/接收/发送也交给 io_uring, 和等待一起批量提交, 完成之后才调用回调函数
+struct Dispatcher IoUringCompletionDispatcher = {
+    uringInit,
+    uringAdd,
+    uringRemove,
+    uringModify,
+    uringDispatch,
+    uringClear,
+    uringAccept,
+    uringRecv,
+    uringSendMsg};
+
+static int uringSetup(unsigned entries, struct io_uring_params *params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize)
+{
+    return syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+bool ioUringSupported()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = uringSetup(8, &params);
+    if (fd == -1)
+    {
+        return false;
+    }
+    close(fd);
+    // 需要内核支持等待时指定超时时间(5.11)
+    return (params.features & IORING_FEAT_EXT_ARG) && (params.features & IORING_FEAT_NODROP);
+}
+
+bool ioUringCompletionSupported()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = uringSetup(8, &params);
+    if (fd == -1)
+    {
+        return false;
+    }
+    // 查询内核支持的操作(5.6)
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = (struct io_uring_probe *)calloc(1, size);
+    bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    const int ops[] = {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_ASYNC_CANCEL};
+    for (size_t i = 0; supported && i < sizeof(ops) / sizeof(ops[0]); ++i)
+    {
+        supported = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    close(fd);
+    return supported;
+}
+
+static void *uringInit()
+{
+    struct IoUringData *data = (struct IoUringData *)calloc(1, sizeof(struct IoUringData));
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    // 只有事件循环所在的线程提交请求, 完成事件也只在等待时处理, 减少内核打断线程的次数
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    data->ringFd = uringSetup(Max, &params);
+    if (data->ringFd == -1 && errno == EINVAL)
+    {
+        // 旧内核不支持上面的标志
+        memset(&params, 0, sizeof(params));
+        data->ringFd = uringSetup(Max, &params);
+    }
+    if (data->ringFd == -1)
+    {
+        perror("io_uring_setup");
+        exit(0);
+    }
+    // 映射提交队列和完成队列
+    data->sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    data->cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        data->sqSize = data->cqSize = data->sqSize > data->cqSize ? data->sqSize : data->cqSize;
+    }
+    data->sqPtr = mmap(NULL, data->sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       data->ringFd, IORING_OFF_SQ_RING);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        data->cqPtr = data->sqPtr;
+    }
+    else
+    {
+        data->cqPtr = mmap(NULL, data->cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           data->ringFd, IORING_OFF_CQ_RING);
+    }
+    data->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    data->sqes = mmap(NULL, data->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      data->ringFd, IORING_OFF_SQES);
+    if (data->sqPtr == MAP_FAILED || data->cqPtr == MAP_FAILED || data->sqes == MAP_FAILED)
+    {
+        perror("mmap");
+        exit(0);
+    }
+    char *sq = (char *)data->sqPtr;
+    data->sqHead = (unsigned *)(sq + params.sq_off.head);
+    data->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    data->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    data->sqArray = (unsigned *)(sq + params.sq_off.array);
+    data->sqEntries = params.sq_entries;
+    char *cq = (char *)data->cqPtr;
+    data->cqHead = (unsigned *)(cq + params.cq_off.head);
+    data->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    data->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    data->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    // 初始化 fd 的注册状态
+    data->size = 128;
+    data->fds = (struct UringFdState *)calloc(data->size, sizeof(struct UringFdState));
+    data->multishotAccept = true;
+    return data;
+}
+
+// 把提交队列中的请求一次性交给内核
+static void uringSubmit(struct IoUringData *data)
+{
+    unsigned pending = *data->sqTail - __atomic_load_n(data->sqHead, __ATOMIC_ACQUIRE);
+    if (pending > 0)
+    {
+        uringEnter(data->ringFd, pending, 0, 0, NULL, 0);
+    }
+}
+
+// 在提交队列中添加一个请求, 只是放到队列中, 等到 dispatch 时和等待操作一起提交
+// 返回请求, 调用者可以继续设置其他字段(内核在 io_uring_enter 时才读取)
+static struct io_uring_sqe *uringQueue(struct IoUringData *data, int opcode, int fd, uint64_t addr, unsigned pollEvents, unsigned len, uint64_t userData)
+{
+    unsigned tail = *data->sqTail;
+    if (tail - __atomic_load_n(data->sqHead, __ATOMIC_ACQUIRE) >= data->sqEntries)
+    {
+        // 队列满了, 先提交一次
+        uringSubmit(data);
+    }
+    unsigned index = tail & *data->sqMask;
+    struct io_uring_sqe *sqe = &data->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = addr;
+    sqe->poll32_events = pollEvents;
+    sqe->len = len;
+    sqe->user_data = userData;
+    data->sqArray[index] = index;
+    __atomic_store_n(data->sqTail, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+static uint64_t uringUserData(struct IoUringData *data, int fd)
+{
+    return (uint64_t)data->fds[fd].gen << 32 | (unsigned)fd;
+}
+
+// 完成模式的操作不带版本号: fd 在操作完成之前不会被关闭, 不会被其他连接复用
+static uint64_t uringOpData(int fd, int op)
+{
+    return (uint64_t)op << 24 | (unsigned)fd;
+}
+
+// 注册 poll 请求: 水平触发的 channel 使用一次性的 poll 请求, 完成之后在 dispatch 中重新注册;
+// 边沿触发的 channel 使用 multishot poll, 一次注册之后每次有新的事件都会产生完成事件
+// 完成模式的 channel 通过 accept/接收操作读取数据, 只在需要等待可写(sendfile)时注册 poll 请求
+static void uringArm(struct IoUringData *data, struct Channel *channel)
+{
+    unsigned events = 0;
+    if ((channel->events & ReadEvent) && !(channel->events & Completion))
+    {
+        events |= POLLIN;
+    }
+    if (channel->events & WriteEvent)
+    {
+        events |= POLLOUT;
+    }
+    if (events == 0)
+    {
+        return;
+    }
+    unsigned flags = channel->events & EdgeTrigger ? IORING_POLL_ADD_MULTI : 0;
+    uringQueue(data, IORING_OP_POLL_ADD, channel->fd, 0, events, flags, uringUserData(data, channel->fd));
+    data->fds[channel->fd].armed = true;
+}
+
+// 取消 fd 还没有完成的 poll 请求, 并使它之后产生的完成事件失效
+static void uringDisarm(struct IoUringData *data, int fd)
+{
+    if (data->fds[fd].armed)
+    {
+        uringQueue(data, IORING_OP_POLL_REMOVE, -1, uringUserData(data, fd), 0, 0, RemoveTag);
+        data->fds[fd].armed = false;
+    }
+    data->fds[fd].gen++;
+}
+
+static int uringAdd(struct Channel *channel, struct EventLoop *evLoop)
+{
+    struct IoUringData *data = (struct IoUringData *)evLoop->dispatcherData;
+    if (channel->fd >= MaxFd)
+    {
+        return -1;
+    }
+    if (channel->fd >= data->size)
+    {
+        int size = data->size;
+        while (size <= channel->fd)
+        {
+            size *= 2;
+        }
+        struct UringFdState *temp = realloc(data->fds, size * sizeof(struct UringFdState));
+        if (temp == NULL)
+        {
+            return -1;
+        }
+        memset(temp + data->size, 0, (size - data->size) * sizeof(struct UringFdState));
+        data->fds = temp;
+        data->size = size;
+    }
+    data->fds[channel->fd].gen++;
+    uringArm(data, channel);
+    return 0;
+}
+
+static int uringRemove(struct Channel *channel, struct EventLoop *evLoop)
+{
+    struct IoUringData *data = (struct IoUringData *)evLoop->dispatcherData;
+    uringDisarm(data, channel->fd);
+    struct UringFdState *state = &data->fds[channel->fd];
+    if (state->removed != NULL)
+    {
+        // 已经删除过了, 正在等待操作完成
+        return 0;
+    }
+    if (state->accepting || state->receiving || state->sending)
+    {
+        // 取消还没有完成的操作, 内核可能还在使用连接的缓冲区, 等它们的完成事件都到了再释放资源
+        const int ops[] = {OpAccept, OpAcceptPoll, OpRecv, OpSend};
+        const bool pending[] = {state->accepting, state->accepting, state->receiving, state->sending};
+        for (int i = 0; i < 4; ++i)
+        {
+            if (pending[i])
+            {
+                uringQueue(data, IORING_OP_ASYNC_CANCEL, -1, uringOpData(channel->fd, ops[i]), 0, 0, RemoveTag);
+            }
+        }
+        state->removed = channel;
+        return 0;
+    }
+    // 通过 channel 释放对应的 TcpConnection 资源
+    channel->destroyCallback(channel->arg);
+    return 0;
+}
+
+// 提交 accept 请求, 新连接直接是非阻塞的
+static void uringQueueAccept(struct IoUringData *data, int fd)
+{
+    struct io_uring_sqe *sqe = uringQueue(data, IORING_OP_ACCEPT, fd, 0, 0, 0, uringOpData(fd, OpAccept));
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    if (data->multishotAccept)
+    {
+        sqe->ioprio |= IORING_ACCEPT_MULTISHOT;
+    }
+    data->fds[fd].accepting = true;
+}
+
+// 文件描述符耗尽时内核的 accept 不等连接到来就会失败, 马上重新提交会一直失败造成忙循环,
+// 先等到监听队列中有连接(可读)再重新提交
+static void uringQueueAcceptPoll(struct IoUringData *data, int fd)
+{
+    uringQueue(data, IORING_OP_POLL_ADD, fd, 0, POLLIN, 0, uringOpData(fd, OpAcceptPoll));
+    data->fds[fd].accepting = true;
+}
+
+static int uringAccept(struct Channel *channel, struct EventLoop *evLoop)
+{
+    struct IoUringData *data = (struct IoUringData *)evLoop->dispatcherData;
+    if (!data->fds[channel->fd].accepting)
+    {
+        uringQueueAccept(data, channel->fd);
+    }
+    return 0;
+}
+
+static int uringRecv(struct Channel *channel, struct EventLoop *evLoop, void *buf, int size)
+{
+    struct IoUringData *data = (struct IoUringData *)evLoop->dispatcherData;
+    uringQueue(data, IORING_OP_RECV, channel->fd, (uint64_t)(uintptr_t)buf, 0, size, uringOpData(channel->fd, OpRecv));
+    data->fds[channel->fd].receiving = true;
+    return 0;
+}
+
+static int uringSendMsg(struct Channel *channel, struct EventLoop *evLoop, struct msghdr *msg)
+{
+    struct IoUringData *data = (struct IoUringData *)evLoop->dispatcherData;
+    struct io_uring_sqe *sqe = uringQueue(data, IORING_OP_SENDMSG, channel->fd, (uint64_t)(uintptr_t)msg, 0, 1,
+                                          uringOpData(channel->fd, OpSend));
+    sqe->msg_flags = MSG_NOSIGNAL;
+    data->fds[channel->fd].sending = true;
+    return 0;
+}
+
+// 完成模式的操作完成了: 设置结果之后调用 channel 的回调函数
+static void uringComplete(struct EventLoop *evLoop, struct IoUringData *data, int fd, int op, int res, unsigned flags)
+{
+    struct UringFdState *state = &data->fds[fd];
+    if (op == OpAccept)
+    {
+        // multishot accept 还会继续产生完成事件
+        state->accepting = (flags & IORING_CQE_F_MORE) != 0;
+    }
+    else if (op == OpAcceptPoll)
+    {
+        state->accepting = false;
+    }
+    else if (op == OpRecv)
+    {
+        state->receiving = false;
+    }
+    else
+    {
+        state->sending = false;
+    }
+    if (state->removed != NULL)
+    {
+        // channel 已经被删除了, 不再调用回调函数, 最后一个操作完成之后释放资源
+        if (!state->accepting && !state->receiving && !state->sending)
+        {
+            struct Channel *channel = state->removed;
+            state->removed = NULL;
+            channel->destroyCallback(channel->arg);
+        }
+        return;
+    }
+    struct Channel *channel = evLoop->channelMap->list[fd];
+    if (channel == NULL)
+    {
+        return;
+    }
+    if (op == OpAcceptPoll)
+    {
+        // 监听队列中有连接了
+        uringQueueAccept(data, fd);
+        return;
+    }
+    channel->result = res;
+    eventActivate(evLoop, fd, op == OpSend ? WriteEvent : ReadEvent);
+    if (op != OpAccept)
+    {
+        return;
+    }
+    // accept 请求结束了(出错, 或者内核不支持 multishot), 监听套接字还在就重新提交
+    // 回调函数中可能添加了新的连接, fds 数组可能已经重新分配了
+    state = &data->fds[fd];
+    if (res == -EINVAL && data->multishotAccept)
+    {
+        data->multishotAccept = false;
+    }
+    else if (res == -EINVAL || res == -ECANCELED)
+    {
+        return;
+    }
+    if (!state->accepting && state->removed == NULL && evLoop->channelMap->list[fd] != NULL)
+    {
+        if (res == -EMFILE || res == -ENFILE)
+        {
+            uringQueueAcceptPoll(data, fd);
+        }
+        else
+        {
+            uringQueueAccept(data, fd);
+        }
+    }
+}
+
+static int uringModify(struct Channel *channel, struct EventLoop *evLoop)
+{
+    struct IoUringData *data = (struct IoUringData *)evLoop->dispatcherData;
+    if (data->fds[channel->fd].removed != NULL)
+    {
+        // 已经删除了, 只是在等待操作完成, 不再注册 poll 请求
+        return 0;
+    }
+    uringDisarm(data, channel->fd);
+    uringArm(data, channel);
+    return 0;
+}
+
+static int uringDispatch(struct EventLoop *evLoop, int timeout)
+{
+    struct IoUringData *data = (struct IoUringData *)evLoop->dispatcherData;
+    // 提交队列中积攒的请求和等待完成事件合并成一次系统调用
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = timeout % 1000 * 1000000LL;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+    unsigned pending = *data->sqTail - __atomic_load_n(data->sqHead, __ATOMIC_ACQUIRE);
+    int ret = uringEnter(data->ringFd, pending, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (ret == -1 && errno != ETIME && errno != EINTR && errno != EBUSY)
+    {
+        perror("io_uring_enter");
+        exit(0);
+    }
+    unsigned head = *data->cqHead;
+    unsigned tail = __atomic_load_n(data->cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        struct io_uring_cqe *cqe = &data->cqes[head & *data->cqMask];
+        uint64_t userData = cqe->user_data;
+        int res = cqe->res;
+        if (userData == RemoveTag)
+        {
+            continue;
+        }
+        int fd = (int)(userData & (MaxFd - 1));
+        int op = (int)((userData >> 24) & 0xff);
+        unsigned gen = (unsigned)(userData >> 32);
+        if (fd >= data->size)
+        {
+            continue;
+        }
+        if (op != OpPoll)
+        {
+            uringComplete(evLoop, data, fd, op, res, cqe->flags);
+            continue;
+        }
+        if (data->fds[fd].gen != gen)
+        {
+            // 已经被修改或者删除的 poll 请求
+            continue;
+        }
+        // multishot poll 还会继续产生完成事件, 不需要重新注册
+        data->fds[fd].armed = (cqe->flags & IORING_CQE_F_MORE) != 0;
+        if (res < 0)
+        {
+            continue;
+        }
+        struct Channel *channel = fd < evLoop->channelMap->size ? evLoop->channelMap->list[fd] : NULL;
+        if (channel != NULL && (channel->events & Completion))
+        {
+            // 完成模式的 channel 只检测可写, 出错时也交给写回调(发送会失败)
+            if (res & (POLLOUT | POLLHUP | POLLERR))
+            {
+                eventActivate(evLoop, fd, WriteEvent);
+            }
+        }
+        else
+        {
+            if (res & (POLLIN | POLLHUP | POLLERR))
+            {
+                eventActivate(evLoop, fd, ReadEvent);
+            }
+            if (res & POLLOUT)
+            {
+                eventActivate(evLoop, fd, WriteEvent);
+            }
+        }
+        // 回调函数中没有修改或者删除这个 fd, poll 请求已经结束则重新注册(等到下一次 dispatch 时一起提交)
+        channel = fd < evLoop->channelMap->size ? evLoop->channelMap->list[fd] : NULL;
+        if (channel != NULL && data->fds[fd].gen == gen && !data->fds[fd].armed)
+        {
+            uringArm(data, channel);
+        }
+    }
+    __atomic_store_n(data->cqHead, head, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static int uringClear(struct EventLoop *evLoop)
+{
+    struct IoUringData *data = (struct IoUringData *)evLoop->dispatcherData;
+    munmap(data->sqes, data->sqesSize);
+    if (data->cqPtr != data->sqPtr)
+    {
+        munmap(data->cqPtr, data->cqSize);
+    }
+    munmap(data->sqPtr, data->sqSize);
+    close(data->ringFd);
+    free(data->fds);
+    free(data);
+    return 0;
+}
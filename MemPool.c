@@ -0,0 +1,120 @@
+#include "MemPool.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 每个线程一个内存池, 事件循环和线程一一对应
+static __thread struct MemPool *localPool = NULL;
+
+// 内存大小对应的等级, 超过 MemPoolMaxSize 返回 -1
+static int sizeClass(size_t size)
+{
+    if (size <= MemPoolSmallMax)
+    {
+        return size == 0 ? 0 : (int)((size + MemPoolSmallStep - 1) / MemPoolSmallStep) - 1;
+    }
+    if (size > MemPoolMaxSize)
+    {
+        return -1;
+    }
+    int index = MemPoolSmallMax / MemPoolSmallStep;
+    size_t classSize = MemPoolSmallMax * 2;
+    while (classSize < size)
+    {
+        classSize <<= 1;
+        index++;
+    }
+    return index;
+}
+
+static size_t classSize(int index)
+{
+    int smallNum = MemPoolSmallMax / MemPoolSmallStep;
+    if (index < smallNum)
+    {
+        return (size_t)(index + 1) * MemPoolSmallStep;
+    }
+    return (size_t)MemPoolSmallMax << (index - smallNum + 1);
+}
+
+// 每个等级最多缓存的空闲块个数
+static int classMaxFree(int index)
+{
+    int num = (int)(MemPoolClassBytes / classSize(index));
+    return num < MemPoolMinFree ? MemPoolMinFree : num;
+}
+
+struct MemPool *memPoolLocal()
+{
+    if (localPool == NULL)
+    {
+        localPool = (struct MemPool *)calloc(1, sizeof(struct MemPool));
+    }
+    return localPool;
+}
+
+size_t memPoolRoundUp(size_t size)
+{
+    int index = sizeClass(size);
+    return index == -1 ? size : classSize(index);
+}
+
+void *memPoolAlloc(size_t size)
+{
+    int index = sizeClass(size);
+    if (index == -1)
+    {
+        return malloc(size);
+    }
+    struct MemPool *pool = memPoolLocal();
+    struct MemBlock *block = pool->freeList[index];
+    if (block != NULL)
+    {
+        pool->freeList[index] = block->next;
+        pool->freeNum[index]--;
+        return block;
+    }
+    return malloc(classSize(index));
+}
+
+void memPoolFree(void *ptr, size_t size)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+    int index = sizeClass(size);
+    struct MemPool *pool = memPoolLocal();
+    if (index == -1 || pool->freeNum[index] >= classMaxFree(index))
+    {
+        free(ptr);
+        return;
+    }
+    struct MemBlock *block = (struct MemBlock *)ptr;
+    block->next = pool->freeList[index];
+    pool->freeList[index] = block;
+    pool->freeNum[index]++;
+}
+
+void *memPoolRealloc(void *ptr, size_t oldSize, size_t newSize)
+{
+    if (ptr == NULL)
+    {
+        return memPoolAlloc(newSize);
+    }
+    if (sizeClass(oldSize) == -1 && sizeClass(newSize) == -1)
+    {
+        return realloc(ptr, newSize);
+    }
+    if (sizeClass(oldSize) == sizeClass(newSize))
+    {
+        return ptr; // 同一个等级, 内存已经够用了
+    }
+    void *temp = memPoolAlloc(newSize);
+    if (temp == NULL)
+    {
+        return NULL;
+    }
+    memcpy(temp, ptr, oldSize < newSize ? oldSize : newSize);
+    memPoolFree(ptr, oldSize);
+    return temp;
+}
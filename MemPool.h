@@ -0,0 +1,35 @@
+#pragma once
+#include <stddef.h>
+
+// 内存池: 每个事件循环(线程)一个, 只在本线程中使用, 不需要加锁
+// 连接, channel, 任务节点, 请求/响应以及缓冲区的内存释放之后按照大小放回空闲链表, 下次分配直接复用,
+// 短连接频繁建立和断开时不再反复调用 malloc/free
+// 大小等级: 64 ~ 1024 字节每 64 字节一级, 之后 2K, 4K, ... 64K 按 2 的幂分级, 更大的内存直接使用 malloc
+// 在另一个线程中释放的内存放到释放线程的内存池中(例如任务节点), 每个等级缓存的内存有上限, 超过之后直接 free
+#define MemPoolSmallStep 64
+#define MemPoolSmallMax 1024
+#define MemPoolMaxSize (64 * 1024)
+#define MemPoolClassNum 22                 // 16 个小对象等级 + 2K ~ 64K 6 个等级
+#define MemPoolClassBytes (2 * 1024 * 1024) // 每个等级最多缓存的空闲内存
+#define MemPoolMinFree 32                   // 每个等级至少可以缓存的空闲块个数
+
+struct MemBlock
+{
+    struct MemBlock *next;
+};
+
+struct MemPool
+{
+    struct MemBlock *freeList[MemPoolClassNum];
+    int freeNum[MemPoolClassNum];
+};
+
+// 得到当前线程的内存池, 第一次调用时创建
+struct MemPool *memPoolLocal();
+// 实际分配的大小(向上取整到所在的等级), 缓冲区可以直接使用多出来的部分
+size_t memPoolRoundUp(size_t size);
+// 分配和释放内存, 释放时需要传入分配时的大小(或者 memPoolRoundUp 之后的大小)
+void *memPoolAlloc(size_t size);
+void memPoolFree(void *ptr, size_t size);
+// 改变内存的大小, 保留原来的数据, 失败返回 NULL(原来的内存不变)
+void *memPoolRealloc(void *ptr, size_t oldSize, size_t newSize);
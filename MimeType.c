@@ -0,0 +1,183 @@
+#include "MimeType.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <pthread.h>
+
+static struct MimeEntry mimeTable[MimeTableSize];
+static int mimeNum = 0;
+static pthread_once_t mimeOnce = PTHREAD_ONCE_INIT;
+
+// 内置的类型
+static const struct
+{
+    const char *ext;
+    const char *type;
+} builtinTypes[] = {
+    // 文本
+    {"html", "text/html; charset=utf-8"},
+    {"htm", "text/html; charset=utf-8"},
+    {"css", "text/css; charset=utf-8"},
+    {"js", "text/javascript; charset=utf-8"},
+    {"mjs", "text/javascript; charset=utf-8"},
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"xml", "application/xml"},
+    {"txt", "text/plain; charset=utf-8"},
+    {"csv", "text/csv; charset=utf-8"},
+    {"md", "text/markdown; charset=utf-8"},
+    {"wasm", "application/wasm"},
+    {"pdf", "application/pdf"},
+    {"pac", "application/x-ns-proxy-autoconfig"},
+    // 图片
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"png", "image/png"},
+    {"gif", "image/gif"},
+    {"webp", "image/webp"},
+    {"avif", "image/avif"},
+    {"svg", "image/svg+xml"},
+    {"ico", "image/x-icon"},
+    {"bmp", "image/bmp"},
+    // 音频
+    {"au", "audio/basic"},
+    {"wav", "audio/wav"},
+    {"mp3", "audio/mpeg"},
+    {"m4a", "audio/mp4"},
+    {"aac", "audio/aac"},
+    {"flac", "audio/flac"},
+    {"oga", "audio/ogg"},
+    {"opus", "audio/opus"},
+    {"midi", "audio/midi"},
+    {"mid", "audio/midi"},
+    {"ogg", "application/ogg"},
+    // 视频
+    {"mp4", "video/mp4"},
+    {"m4v", "video/mp4"},
+    {"webm", "video/webm"},
+    {"ogv", "video/ogg"},
+    {"mkv", "video/x-matroska"},
+    {"avi", "video/x-msvideo"},
+    {"mov", "video/quicktime"},
+    {"qt", "video/quicktime"},
+    {"mpeg", "video/mpeg"},
+    {"mpe", "video/mpeg"},
+    {"mpg", "video/mpeg"},
+    {"ts", "video/mp2t"},
+    {"m3u8", "application/vnd.apple.mpegurl"},
+    {"vrml", "model/vrml"},
+    {"wrl", "model/vrml"},
+    // 字体
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+    {"otf", "font/otf"},
+    // 压缩文件
+    {"zip", "application/zip"},
+    {"gz", "application/gzip"},
+    {"tar", "application/x-tar"},
+};
+
+// FNV-1a, 按照小写计算
+static unsigned int extHash(const char *ext, int length)
+{
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < length; ++i)
+    {
+        hash = (hash ^ (unsigned char)tolower((unsigned char)ext[i])) * 16777619u;
+    }
+    return hash;
+}
+
+// 查找扩展名所在的位置: 已经存在的位置或者第一个空位置, 表满了返回 NULL
+static struct MimeEntry *findSlot(const char *ext, int length)
+{
+    unsigned int index = extHash(ext, length) & (MimeTableSize - 1);
+    for (int i = 0; i < MimeTableSize; ++i)
+    {
+        struct MimeEntry *entry = &mimeTable[(index + i) & (MimeTableSize - 1)];
+        if (entry->ext[0] == '\0' || (strncasecmp(entry->ext, ext, length) == 0 && entry->ext[length] == '\0'))
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void mimeTypeAdd(const char *ext, int length, const char *type)
+{
+    // 哈希表最多使用一半, 保证查找时很快就能遇到空位置
+    if (length <= 0 || length >= MimeExtMax || mimeNum >= MimeTableSize / 2)
+    {
+        return;
+    }
+    struct MimeEntry *entry = findSlot(ext, length);
+    if (entry->ext[0] == '\0')
+    {
+        for (int i = 0; i < length; ++i)
+        {
+            entry->ext[i] = tolower((unsigned char)ext[i]);
+        }
+        entry->ext[length] = '\0';
+        mimeNum++;
+    }
+    entry->type = type;
+}
+
+static void mimeTypeInit()
+{
+    for (int i = 0; i < (int)(sizeof(builtinTypes) / sizeof(builtinTypes[0])); ++i)
+    {
+        mimeTypeAdd(builtinTypes[i].ext, strlen(builtinTypes[i].ext), builtinTypes[i].type);
+    }
+}
+
+int mimeTypeLoad(const char *path)
+{
+    pthread_once(&mimeOnce, mimeTypeInit);
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        return -1;
+    }
+    int num = 0;
+    char line[1024];
+    const char *delim = " \t\r\n";
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        char *save = NULL;
+        char *type = strtok_r(line, delim, &save);
+        if (type == NULL || type[0] == '#')
+        {
+            continue;
+        }
+        // 类型字符串一直使用, 不释放
+        const char *saved = NULL;
+        char *ext;
+        while ((ext = strtok_r(NULL, delim, &save)) != NULL && ext[0] != '#')
+        {
+            if (saved == NULL)
+            {
+                saved = strdup(type);
+            }
+            mimeTypeAdd(ext, strlen(ext), saved);
+            num++;
+        }
+    }
+    fclose(fp);
+    return num;
+}
+
+const char *mimeTypeLookup(const char *ext)
+{
+    pthread_once(&mimeOnce, mimeTypeInit);
+    int length = strlen(ext);
+    if (length == 0 || length >= MimeExtMax)
+    {
+        return NULL;
+    }
+    struct MimeEntry *entry = findSlot(ext, length);
+    return entry != NULL && entry->ext[0] != '\0' ? entry->type : NULL;
+}
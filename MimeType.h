@@ -0,0 +1,18 @@
+#pragma once
+
+// 文件扩展名 -> Content-Type 的哈希表(开放寻址), 查找不区分大小写, 不分配内存
+// 内置常用的类型, 启动时可以再加载 mime.types 文件(覆盖内置的类型), 之后只读, 多个线程可以同时查找
+#define MimeTableSize 2048 // 哈希表的容量, 必须是 2 的幂
+#define MimeExtMax 16      // 扩展名的最大长度(包括 '\0')
+
+struct MimeEntry
+{
+    char ext[MimeExtMax]; // 小写的扩展名, 空字符串表示没有使用
+    const char *type;
+};
+
+// 加载 mime.types 格式的文件: 每行 "类型 扩展名1 扩展名2 ...", # 开头的是注释
+// 需要在启动服务器之前调用, 返回加载的扩展名个数, 打开文件失败返回 -1
+int mimeTypeLoad(const char *path);
+// 根据扩展名(不包括 '.')查找类型, 找不到返回 NULL
+const char *mimeTypeLookup(const char *ext);
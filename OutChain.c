@@ -0,0 +1,245 @@
+#include "OutChain.h"
+#include "MemPool.h"
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+
+static struct ChainLink *linkInit(struct OutChain *chain, int type)
+{
+    struct ChainLink *link = (struct ChainLink *)memPoolAlloc(sizeof(struct ChainLink));
+    link->type = type;
+    link->data = link->block = NULL;
+    link->capacity = 0;
+    link->fd = -1;
+    link->offset = link->length = 0;
+    link->release = NULL;
+    link->arg = NULL;
+    link->next = NULL;
+    if (chain->tail == NULL)
+    {
+        chain->head = chain->tail = link;
+    }
+    else
+    {
+        chain->tail->next = link;
+        chain->tail = link;
+    }
+    return link;
+}
+
+// 删除头部的一段数据
+static void linkPop(struct OutChain *chain)
+{
+    struct ChainLink *link = chain->head;
+    chain->head = link->next;
+    if (chain->head == NULL)
+    {
+        chain->tail = NULL;
+    }
+    if (link->block != NULL)
+    {
+        chain->ownedBytes -= link->length;
+        memPoolFree(link->block, link->capacity);
+    }
+    if (link->release != NULL)
+    {
+        link->release(link->arg);
+    }
+    memPoolFree(link, sizeof(struct ChainLink));
+}
+
+void outChainInit(struct OutChain *chain)
+{
+    chain->head = chain->tail = NULL;
+    chain->ownedBytes = 0;
+}
+
+void outChainClear(struct OutChain *chain)
+{
+    while (chain->head != NULL)
+    {
+        linkPop(chain);
+    }
+}
+
+bool outChainEmpty(struct OutChain *chain)
+{
+    return chain->head == NULL;
+}
+
+char *outChainReserve(struct OutChain *chain, int size)
+{
+    struct ChainLink *link = chain->tail;
+    // 最后一段是自己拥有的内存, 并且剩下的空间够用, 直接追加在后面
+    if (link != NULL && link->block != NULL && link->data + link->length + size <= link->block + link->capacity)
+    {
+        return link->data + link->length;
+    }
+    link = linkInit(chain, ChainMemory);
+    link->capacity = (int)memPoolRoundUp(size > ChainBlockSize ? size : ChainBlockSize);
+    link->block = link->data = (char *)memPoolAlloc(link->capacity);
+    return link->data;
+}
+
+void outChainCommit(struct OutChain *chain, int size)
+{
+    chain->tail->length += size;
+    chain->ownedBytes += size;
+}
+
+void outChainAppendData(struct OutChain *chain, const char *data, int size)
+{
+    if (size <= 0)
+    {
+        return;
+    }
+    memcpy(outChainReserve(chain, size), data, size);
+    outChainCommit(chain, size);
+}
+
+void outChainAppendBuffer(struct OutChain *chain, struct Buffer *buffer)
+{
+    int readable = bufferReadableSize(buffer);
+    if (readable == 0)
+    {
+        return;
+    }
+    if (readable <= ChainBlockSize / 2 || buffer->pinned > 0)
+    {
+        // 数据比较少: 拷贝到最后一个内存块中, 多个响应头可以放在同一块内存中
+        outChainAppendData(chain, buffer->data + buffer->readPos, readable);
+        buffer->readPos = buffer->writePos = 0;
+        return;
+    }
+    // 数据比较多: 直接接管缓冲区的内存块, 缓冲区从内存池中换一块同样大小的内存
+    struct ChainLink *link = linkInit(chain, ChainMemory);
+    link->block = buffer->data;
+    link->capacity = buffer->capacity;
+    link->data = buffer->data + buffer->readPos;
+    link->length = readable;
+    chain->ownedBytes += readable;
+    buffer->data = (char *)memPoolAlloc(buffer->capacity);
+    buffer->readPos = buffer->writePos = 0;
+}
+
+void outChainAppendRef(struct OutChain *chain, const char *data, int size, chainRelease release, void *arg)
+{
+    if (size <= 0)
+    {
+        if (release != NULL)
+        {
+            release(arg);
+        }
+        return;
+    }
+    struct ChainLink *link = linkInit(chain, ChainMemory);
+    link->data = (char *)data;
+    link->length = size;
+    link->release = release;
+    link->arg = arg;
+}
+
+void outChainAppendFile(struct OutChain *chain, int fd, off_t offset, off_t length, chainRelease release, void *arg)
+{
+    if (length <= 0)
+    {
+        if (release != NULL)
+        {
+            release(arg);
+        }
+        return;
+    }
+    struct ChainLink *link = linkInit(chain, ChainFile);
+    link->fd = fd;
+    link->offset = offset;
+    link->length = length;
+    link->release = release;
+    link->arg = arg;
+}
+
+bool outChainSingleSend(struct OutChain *chain)
+{
+    int num = 0;
+    for (struct ChainLink *link = chain->head; link != NULL; link = link->next)
+    {
+        if (link->type != ChainMemory || ++num > ChainMaxIov)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int outChainFillIov(struct OutChain *chain, struct iovec *vec, int max)
+{
+    int num = 0;
+    for (struct ChainLink *link = chain->head; link != NULL && link->type == ChainMemory && num < max; link = link->next)
+    {
+        vec[num].iov_base = link->data;
+        vec[num].iov_len = link->length;
+        num++;
+    }
+    return num;
+}
+
+void outChainConsume(struct OutChain *chain, ssize_t count)
+{
+    // 删除已经发送完毕的内存段, 最后一段可能只发送了一部分
+    ssize_t left = count;
+    while (left > 0)
+    {
+        struct ChainLink *link = chain->head;
+        if (left >= link->length)
+        {
+            left -= link->length;
+            linkPop(chain);
+        }
+        else
+        {
+            link->data += left;
+            link->length -= left;
+            if (link->block != NULL)
+            {
+                chain->ownedBytes -= left;
+            }
+            left = 0;
+        }
+    }
+    // 长度为 0 的内存段(预留之后没有写入数据)直接删除
+    while (chain->head != NULL && chain->head->type == ChainMemory && chain->head->length == 0)
+    {
+        linkPop(chain);
+    }
+}
+
+ssize_t outChainSend(struct OutChain *chain, int socket)
+{
+    struct ChainLink *link = chain->head;
+    if (link == NULL)
+    {
+        return 0;
+    }
+    if (link->type == ChainFile)
+    {
+        // 文件段: sendfile 零拷贝
+        ssize_t count = sendfile(socket, link->fd, &link->offset, link->length);
+        if (count > 0)
+        {
+            link->length -= count;
+            if (link->length == 0)
+            {
+                linkPop(chain);
+            }
+        }
+        return count;
+    }
+    // 连续的内存段: 一次 sendmsg
+    struct iovec vec[ChainMaxIov];
+    struct msghdr msg = {0};
+    msg.msg_iov = vec;
+    msg.msg_iovlen = outChainFillIov(chain, vec, ChainMaxIov);
+    ssize_t count = sendmsg(socket, &msg, MSG_NOSIGNAL);
+    outChainConsume(chain, count);
+    return count;
+}
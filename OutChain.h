@@ -0,0 +1,70 @@
+#pragma once
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "Buffer.h"
+
+// 输出链: 连接要发送的数据由多段组成, 按顺序发送
+// 1. 自己拥有的内存(响应头, 生成的页面等), 从内存池中分配, 发送完毕之后释放
+// 2. 借用的内存(热点文件缓存的内容, 静态字符串), 不拷贝, 发送完毕之后调用 release 归还
+// 3. 文件中的一段, 使用 sendfile 零拷贝发送
+// 连续的内存段通过一次 sendmsg 发送, 响应头和响应体不需要先拷贝到一起
+#define ChainBlockSize 4096 // 自己拥有的内存块的默认大小, 小块数据追加到最后一个内存块中
+#define ChainMaxIov 64      // 一次 sendmsg 最多发送的内存段个数
+
+enum ChainLinkType
+{
+    ChainMemory,
+    ChainFile
+};
+
+// 一段数据发送完毕或者被丢弃时调用, 用来归还借用的内存或者关闭文件
+typedef void (*chainRelease)(void *arg);
+
+struct ChainLink
+{
+    int type;
+    char *data;     // 内存段中下一个要发送的字节
+    char *block;    // 自己拥有的内存块, NULL 表示借用的内存
+    int capacity;   // 内存块的大小
+    int fd;         // 文件段的文件描述符
+    off_t offset;   // 文件段中下一个要发送的位置
+    off_t length;   // 剩下还没有发送的字节数
+    chainRelease release;
+    void *arg;
+    struct ChainLink *next;
+};
+
+struct OutChain
+{
+    struct ChainLink *head;
+    struct ChainLink *tail;
+    int ownedBytes; // 自己拥有的内存中还没有发送的字节数, 用来限制每个连接占用的内存
+};
+
+// 初始化
+void outChainInit(struct OutChain *chain);
+// 丢弃所有还没有发送的数据(归还借用的内存, 关闭文件), 连接断开时调用
+void outChainClear(struct OutChain *chain);
+// 是否已经全部发送完毕
+bool outChainEmpty(struct OutChain *chain);
+// 追加数据, 拷贝到自己拥有的内存中
+void outChainAppendData(struct OutChain *chain, const char *data, int size);
+// 把 buffer 中所有可读的数据移动到输出链中, 数据比较多的时候直接接管 buffer 的内存块(buffer 换一块新的内存)
+void outChainAppendBuffer(struct OutChain *chain, struct Buffer *buffer);
+// 在自己拥有的内存中预留 size 个字节, 写入之后调用 outChainCommit 提交实际写入的字节数
+char *outChainReserve(struct OutChain *chain, int size);
+void outChainCommit(struct OutChain *chain, int size);
+// 追加借用的内存, 发送完毕之后调用 release(arg), release 可以为 NULL(静态数据)
+void outChainAppendRef(struct OutChain *chain, const char *data, int size, chainRelease release, void *arg);
+// 追加文件中的一段, 发送完毕之后调用 release(arg)
+void outChainAppendFile(struct OutChain *chain, int fd, off_t offset, off_t length, chainRelease release, void *arg);
+// 输出链中的数据能否通过一次 sendmsg 全部发送(只有内存段, 并且不超过 ChainMaxIov 段)
+bool outChainSingleSend(struct OutChain *chain);
+// 把头部连续的内存段(最多 max 段)填到 vec 中, 返回段数, 头部是文件段时返回 0
+int outChainFillIov(struct OutChain *chain, struct iovec *vec, int max);
+// 头部的内存段已经发送了 count 个字节, 删除发送完毕的内存段
+void outChainConsume(struct OutChain *chain, ssize_t count);
+// 发送输出链头部的数据: 连续的内存段一次 sendmsg, 文件段一次 sendfile
+// 返回发送的字节数, -1 出错(errno 为 EAGAIN 表示套接字暂时不可写)
+ssize_t outChainSend(struct OutChain *chain, int socket);
@@ -2,6 +2,7 @@
 #include <poll.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
 
 #define Max 1024
 struct PollData
@@ -14,7 +15,7 @@ static void* pollInit();
 static int pollAdd(struct Channel* channel, struct EventLoop* evLoop);
 static int pollRemove(struct Channel* channel, struct EventLoop* evLoop);
 static int pollModify(struct Channel* channel, struct EventLoop* evLoop);
-static int pollDispatch(struct EventLoop* evLoop, int timeout); // 单位: s
+static int pollDispatch(struct EventLoop* evLoop, int timeout); // 单位: ms
 static int pollClear(struct EventLoop* evLoop);
 
 struct Dispatcher PollDispatcher = {
@@ -23,7 +24,10 @@ struct Dispatcher PollDispatcher = {
     pollRemove,
     pollModify,
     pollDispatch,
-    pollClear
+    pollClear,
+    NULL, // 不支持完成模式
+    NULL,
+    NULL
 };
 
 static void* pollInit()
@@ -124,12 +128,16 @@ static int pollModify(struct Channel* channel, struct EventLoop* evLoop)
 static int pollDispatch(struct EventLoop* evLoop, int timeout)
 {
     struct PollData* data = (struct PollData*)evLoop->dispatcherData;
-    int count = poll(data->fds, data->maxfd+1, timeout * 1000);
-    if (count == -1)
+    int count = poll(data->fds, data->maxfd+1, timeout);
+    if (count == -1 && errno != EINTR)
     {
         perror("poll");
         exit(0);
     }
+    if (count <= 0)
+    {
+        return 0; // 超时或者被信号中断
+    }
     for (int i = 0; i <= data->maxfd; ++i)
     {
         if (data->fds[i].fd == -1)
@@ -137,7 +145,7 @@ static int pollDispatch(struct EventLoop* evLoop, int timeout)
             continue;
         }
         
-        if (data->fds[i].revents & POLLIN)
+        if (data->fds[i].revents & (POLLIN | POLLHUP | POLLERR))
         {
             eventActivate(evLoop, data->fds[i].fd, ReadEvent);
         }
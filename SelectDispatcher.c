@@ -2,6 +2,7 @@
 #include <sys/select.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 
 #define Max 1024
 struct SelectData
@@ -14,7 +15,7 @@ static void* selectInit();
 static int selectAdd(struct Channel* channel, struct EventLoop* evLoop);
 static int selectRemove(struct Channel* channel, struct EventLoop* evLoop);
 static int selectModify(struct Channel* channel, struct EventLoop* evLoop);
-static int selectDispatch(struct EventLoop* evLoop, int timeout); // 单位: s
+static int selectDispatch(struct EventLoop* evLoop, int timeout); // 单位: ms
 static int selectClear(struct EventLoop* evLoop);
 static void setFdSet(struct Channel* channel, struct SelectData* data);
 static void clearFdSet(struct Channel* channel, struct SelectData* data);
@@ -25,7 +26,10 @@ struct Dispatcher SelectDispatcher = {
     selectRemove,
     selectModify,
     selectDispatch,
-    selectClear
+    selectClear,
+    NULL, // 不支持完成模式
+    NULL,
+    NULL
 };
 
 static void* selectInit()
@@ -84,8 +88,10 @@ static int selectRemove(struct Channel* channel, struct EventLoop* evLoop)
 static int selectModify(struct Channel* channel, struct EventLoop* evLoop)
 {
     struct SelectData* data = (struct SelectData*)evLoop->dispatcherData;
+    // 先清除旧的读写事件, 再按照 channel 中新的事件重新设置
+    FD_CLR(channel->fd, &data->readSet);
+    FD_CLR(channel->fd, &data->writeSet);
     setFdSet(channel, data);
-    clearFdSet(channel, data);
     return 0;
 }
 
@@ -93,16 +99,20 @@ static int selectDispatch(struct EventLoop* evLoop, int timeout)
 {
     struct SelectData* data = (struct SelectData*)evLoop->dispatcherData;
     struct timeval val;
-    val.tv_sec = timeout;
-    val.tv_usec = 0;
+    val.tv_sec = timeout / 1000;
+    val.tv_usec = timeout % 1000 * 1000;
     fd_set rdtmp = data->readSet;
     fd_set wrtmp = data->writeSet;
     int count = select(Max, &rdtmp, &wrtmp, NULL, &val);
-    if (count == -1)
+    if (count == -1 && errno != EINTR)
     {
         perror("select");
         exit(0);
     }
+    if (count <= 0)
+    {
+        return 0; // 超时或者被信号中断
+    }
     for (int i = 0; i < Max; ++i)
     {
         if (FD_ISSET(i, &rdtmp))
@@ -2,43 +2,339 @@
 #include "HttpRequest.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include "Log.h"
-// 读事件处理函数，接收客户端发来的数据
-int processRead(void *arg)
+#include "MemPool.h"
+static int processRequest(struct TcpConnection *conn);
+
+// 完成模式: 提交一个接收操作, 数据由内核直接写到读缓冲区中, 完成之后调用读回调
+// 接收完成之前不能修改读缓冲区, 因此只在等待客户端数据(请求不完整, 响应已经发送完毕)时提交
+static void tcpConnectionWaitRead(struct TcpConnection *conn)
 {
-    struct TcpConnection *conn = (struct TcpConnection *)arg;
-    // 接收数据
-    int count = bufferSocketRead(conn->readBuf, conn->channel->fd);
+    if (!conn->completion || conn->reading)
+    {
+        return;
+    }
+    char *buf = bufferPrepareRead(conn->readBuf, &conn->readSize);
+    conn->reading = true;
+    eventLoopRecv(conn->evLoop, conn->channel, buf, conn->readSize);
+}
 
-    Debug("接收到的http请求数据: %s", conn->readBuf->data + conn->readBuf->readPos);
+// 设置/取消 TCP_CORK: 设置之后内核只发送满的报文段, 取消时把剩下的数据立即发送出去
+static void tcpConnectionCork(struct TcpConnection *conn, bool cork)
+{
+    int value = cork ? 1 : 0;
+    setsockopt(conn->channel->fd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+    conn->corked = cork;
+}
 
-    if (count > 0)
+// 发送响应数据: 写缓冲区中的数据和响应体依次挂到输出链上, 连续的内存段通过一次 sendmsg 发送, 大文件使用 sendfile
+// 响应体的数据只有在输出链中的数据发送出去之后才继续生成, 因此不论文件多大, 每个连接占用的内存都不会超过水位线太多
+// 返回值: 1 数据全部发送完毕, 0 套接字暂时不可写需要等待写事件, -1 出错
+static int tcpConnectionFlush(struct TcpConnection *conn)
+{
+    int socket = conn->channel->fd;
+    while (true)
     {
-        // 接收到了 http 请求, 解析http请求
-        int socket = conn->channel->fd;
-#ifdef MSG_SEND_AUTO
-        writeEventEnable(conn->channel, true);
+        bool done = httpResponseChainBody(conn->response, conn->writeBuf, &conn->chain, WriteWatermark);
+        // 响应头和小的响应体一次 sendmsg 就能发送完毕, 不需要 TCP_CORK;
+        // 需要多次发送时(sendfile, 还要继续生成数据)先设置 TCP_CORK, 避免响应头等小块数据单独成为一个报文段
+        if (!conn->corked && (!done || !outChainSingleSend(&conn->chain)))
+        {
+            tcpConnectionCork(conn, true);
+        }
+        while (!outChainEmpty(&conn->chain))
+        {
+            if (conn->completion && conn->chain.head->type == ChainMemory)
+            {
+                // 完成模式: 连续的内存段交给内核发送, 完成之后在写回调中删除发送完毕的内存段
+                // 文件段仍然使用 sendfile(io_uring 没有对应的操作), 套接字不可写时等待写事件
+                conn->msg.msg_iov = conn->vec;
+                conn->msg.msg_iovlen = outChainFillIov(&conn->chain, conn->vec, ChainMaxIov);
+                conn->sending = true;
+                eventLoopSendMsg(conn->evLoop, conn->channel, &conn->msg);
+                return 0;
+            }
+            ssize_t count = outChainSend(&conn->chain, socket);
+            if (count == -1 && errno == EAGAIN)
+            {
+                return 0;
+            }
+            if (count <= 0)
+            {
+                // 出错或者文件在发送过程中被截断了
+                return -1;
+            }
+        }
+        if (done)
+        {
+            // 响应已经全部交给内核, 取消 TCP_CORK 把最后不满一个报文段的数据发送出去
+            if (conn->corked)
+            {
+                tcpConnectionCork(conn, false);
+            }
+            return 1;
+        }
+    }
+}
+
+// 关闭连接: 先关闭写端, 之后读取并丢弃客户端的数据, 直到客户端关闭连接或者超时再释放连接
+// 流水线中客户端可能已经发来了后面的请求, 套接字中有未读取的数据时直接 close 内核会发送 RST,
+// 客户端可能还没有收到的最后一个响应会被丢弃
+static void tcpConnectionLinger(struct TcpConnection *conn)
+{
+    shutdown(conn->channel->fd, SHUT_WR);
+    conn->closing = true;
+    eventLoopAddTimer(conn->evLoop, &conn->timer, LingerTimeout);
+    tcpConnectionWaitRead(conn);
+}
+
+// 发送响应数据, 发送完毕之后根据是否是长连接决定断开连接还是处理下一个请求
+static int tcpConnectionSend(struct TcpConnection *conn)
+{
+    int ret = tcpConnectionFlush(conn);
+    if (ret == 0)
+    {
+        // 客户端长时间不接收数据也要断开连接
+        eventLoopAddTimer(conn->evLoop, &conn->timer, IdleTimeout);
+        if (conn->sending)
+        {
+            // 完成模式: 发送完成之后会调用写回调, 不需要检测写事件
+            if (isWriteEventEnable(conn->channel))
+            {
+                writeEventEnable(conn->channel, false);
+                eventLoopAddTask(conn->evLoop, conn->channel, MODIFY);
+            }
+            return 0;
+        }
+        // 数据没有发完, 检测写事件, 可写之后继续发送
+        // 同时不再检测读事件: 客户端只发请求不接收响应时, 读缓冲区不会无限增长, 新的请求留在套接字中
+        if (!isWriteEventEnable(conn->channel))
+        {
+            writeEventEnable(conn->channel, true);
+            readEventEnable(conn->channel, false);
+            eventLoopAddTask(conn->evLoop, conn->channel, MODIFY);
+        }
+        return 0;
+    }
+    if (isWriteEventEnable(conn->channel))
+    {
+        // 1. 不再检测写事件, 重新检测读事件 -- 修改channel中保存的事件
+        writeEventEnable(conn->channel, false);
+        readEventEnable(conn->channel, true);
+        // 2. 修改dispatcher检测的集合 -- 添加任务节点
         eventLoopAddTask(conn->evLoop, conn->channel, MODIFY);
-#endif
+    }
+    // 当前响应发送完毕(关闭响应体对应的文件)
+    httpResponseReset(conn->response);
+    if (ret == -1)
+    {
+        // 3. 发送出错: 删除这个节点
+        eventLoopAddTask(conn->evLoop, conn->channel, DELETE);
+        return 0;
+    }
+    if (!conn->keepAlive)
+    {
+        // 4. 短连接: 等客户端关闭之后再删除这个节点
+        tcpConnectionLinger(conn);
+        return 0;
+    }
+    // 等待下一个请求, 空闲超时之后断开连接
+    eventLoopAddTimer(conn->evLoop, &conn->timer, IdleTimeout);
+    // 长连接: 发送期间客户端可能已经发来了下一个请求
+    if (bufferReadableSize(conn->readBuf) > 0)
+    {
+        return processRequest(conn);
+    }
+    tcpConnectionWaitRead(conn);
+    return 0;
+}
+
+// 解析读缓冲区中的 http 请求并回复
+// 流水线: 读缓冲区中还有完整的请求, 并且当前响应能够完整地挂到输出链上时, 继续处理下一个请求,
+// 多个响应按照请求的顺序排列在输出链中, 最后一起发送
+static int processRequest(struct TcpConnection *conn)
+{
+    int socket = conn->channel->fd;
+    int num = 0; // 这一批处理的请求个数
+    while (true)
+    {
+        // 是否还允许复用这个连接, 最终结果由解析请求时结合客户端的请求头确定
+        conn->response->keepAlive = conn->requestNum + 1 < MaxKeepAliveRequests;
         bool flag = parseHttpRequest(conn->request, conn->readBuf, conn->response, conn->writeBuf, socket);
-        if (!flag)
+        if (flag)
+        {
+            // 一个请求处理完毕, 响应发送完毕之后再重置 response
+            conn->requestNum++;
+            conn->keepAlive = conn->response->keepAlive;
+        }
+        else if (httpRequestState(conn->request) == ParseReqError ||
+                 (num == 0 && bufferReadableSize(conn->readBuf) >= ReadBufferMax))
         {
-            // 解析失败, 回复一个简单的html
-            char *errMsg = "Http/1.1 400 Bad Request\r\n\r\n";
+            // 解析失败(或者超过读缓冲区的上限仍然不是一个完整的请求), 回复一个简单的html
+            char *errMsg = "HTTP/1.1 400 Bad Request\r\nConnection: close\r\n\r\n";
             bufferAppendString(conn->writeBuf, errMsg);
+            conn->keepAlive = false;
+        }
+        else if (num == 0)
+        {
+            // 请求数据还不完整, 继续等待客户端发送剩余的数据
+            // 截止时间从收到请求的第一块数据开始计算, 之后收到数据也不延长, 防止客户端一个字节一个字节地发送
+            if (!conn->headerDeadline)
+            {
+                conn->headerDeadline = true;
+                eventLoopAddTimer(conn->evLoop, &conn->timer, HeaderTimeout);
+            }
+            tcpConnectionWaitRead(conn);
+            return 0;
         }
+        else
+        {
+            // 后面的请求还不完整, 先发送已经处理好的响应, 发送完毕之后再继续解析
+            break;
+        }
+        conn->headerDeadline = false;
+        num++;
+        if (!flag || !conn->keepAlive || num >= MaxPipelineRequests ||
+            bufferReadableSize(conn->readBuf) == 0 ||
+            !httpResponseChainBody(conn->response, conn->writeBuf, &conn->chain, WriteWatermark))
+        {
+            break;
+        }
+        // 当前响应已经全部在输出链中了, 可以处理下一个请求
+        httpResponseReset(conn->response);
     }
-    else
-    {
 #ifdef MSG_SEND_AUTO
-        // 断开连接
+    // 数据由写事件发送, 发送完毕之后再决定是否断开连接, 发送期间不读取新的请求
+    writeEventEnable(conn->channel, true);
+    readEventEnable(conn->channel, false);
+    eventLoopAddTask(conn->evLoop, conn->channel, MODIFY);
+    return 0;
+#else
+    return tcpConnectionSend(conn);
+#endif
+}
+
+// 完成模式: 接收操作完成了, 数据已经在读缓冲区中
+static int tcpConnectionRecvDone(struct TcpConnection *conn)
+{
+    conn->reading = false;
+    int result = conn->channel->result;
+    if (result == -EAGAIN || result == -EINTR)
+    {
+        tcpConnectionWaitRead(conn);
+        return 0;
+    }
+    if (result <= 0)
+    {
+        // 客户端断开了连接或者出错
         eventLoopAddTask(conn->evLoop, conn->channel, DELETE);
+        return 0;
+    }
+    bufferCommitRead(conn->readBuf, result, conn->readSize);
+    if (conn->closing)
+    {
+        // 写端已经关闭, 丢弃客户端的数据
+        conn->readBuf->readPos = conn->readBuf->writePos = 0;
+        tcpConnectionWaitRead(conn);
+        return 0;
+    }
+    Debug("接收到的http请求数据: %.*s", bufferReadableSize(conn->readBuf), conn->readBuf->data + conn->readBuf->readPos);
+    return processRequest(conn);
+}
+
+// 读事件处理函数，接收客户端发来的数据
+int processRead(void *arg)
+{
+    struct TcpConnection *conn = (struct TcpConnection *)arg;
+    if (conn->completion)
+    {
+        return tcpConnectionRecvDone(conn);
+    }
+    if (isWriteEventEnable(conn->channel))
+    {
+        // 上一个响应还没有发送完毕, 已经不再检测读事件(同一批事件中可能还有之前的读事件),
+        // 新的请求留在套接字中, 发送完毕重新检测读事件之后再读取
+        return 0;
+    }
+    if (conn->closing)
+    {
+        // 写端已经关闭, 丢弃客户端的数据, 客户端关闭连接(或者出错)之后释放连接
+        conn->readBuf->readPos = conn->readBuf->writePos = 0;
+        int ret = bufferSocketRead(conn->readBuf, conn->channel->fd);
+#ifdef EPOLL_ET_MODE
+        while (ret > 0)
+        {
+            conn->readBuf->readPos = conn->readBuf->writePos = 0;
+            ret = bufferSocketRead(conn->readBuf, conn->channel->fd);
+        }
 #endif
+        if (ret == 0 || (ret == -1 && errno != EAGAIN))
+        {
+            eventLoopAddTask(conn->evLoop, conn->channel, DELETE);
+        }
+        return 0;
+    }
+    // 接收数据
+    int count = bufferSocketRead(conn->readBuf, conn->channel->fd);
+#ifdef EPOLL_ET_MODE
+    // 边沿触发: 一直读到 EAGAIN, 否则套接字中剩下的数据不会再触发读事件
+    // 读缓冲区中的数据达到上限时先停下来, 重新设置一次事件, 剩下的数据会再次触发读事件
+    while (count > 0)
+    {
+        if (bufferReadableSize(conn->readBuf) >= ReadBufferMax)
+        {
+            eventLoopAddTask(conn->evLoop, conn->channel, MODIFY);
+            break;
+        }
+        int ret = bufferSocketRead(conn->readBuf, conn->channel->fd);
+        if (ret <= 0)
+        {
+            count = ret == -1 && errno == EAGAIN ? count : ret;
+            break;
+        }
+        count += ret;
     }
-#ifndef MSG_SEND_AUTO
-    // 断开连接
-    eventLoopAddTask(conn->evLoop, conn->channel, DELETE);
 #endif
+
+    // 缓冲区中的数据不一定以 '\0' 结尾, 需要指定长度
+    Debug("接收到的http请求数据: %.*s", bufferReadableSize(conn->readBuf), conn->readBuf->data + conn->readBuf->readPos);
+
+    if (count == -1 && errno == EAGAIN)
+    {
+        // 非阻塞套接字暂时没有数据
+        return 0;
+    }
+    if (count <= 0)
+    {
+        // 客户端断开了连接
+        eventLoopAddTask(conn->evLoop, conn->channel, DELETE);
+        return 0;
+    }
+    // 接收到了 http 请求, 解析http请求
+    return processRequest(conn);
+}
+
+// 超时处理函数, 断开连接
+static int tcpConnectionTimeout(void *arg)
+{
+    struct TcpConnection *conn = (struct TcpConnection *)arg;
+    Debug("连接超时, connName: %s", conn->name);
+    eventLoopAddTask(conn->evLoop, conn->channel, DELETE);
+    return 0;
+}
+
+// 在子线程中把连接添加到事件循环中, 并开始空闲超时检测
+static int tcpConnectionStart(void *arg)
+{
+    struct TcpConnection *conn = (struct TcpConnection *)arg;
+    eventLoopAdd(conn->evLoop, conn->channel);
+    eventLoopAddTimer(conn->evLoop, &conn->timer, IdleTimeout);
+    tcpConnectionWaitRead(conn);
     return 0;
 }
 
@@ -46,36 +342,58 @@ int processWrite(void *arg)
 {
     Debug("开始发送数据了(基于写事件发送)....");
     struct TcpConnection *conn = (struct TcpConnection *)arg;
-    // 发送数据
-    int count = bufferSendData(conn->writeBuf, conn->channel->fd);
-    if (count > 0)
+    if (conn->sending)
     {
-        // 判断数据是否被全部发送出去了
-        if (bufferReadableSize(conn->writeBuf) == 0)
+        // 完成模式: 发送操作完成了, 删除已经发送的数据之后继续发送
+        conn->sending = false;
+        int result = conn->channel->result;
+        if (result < 0 && result != -EAGAIN && result != -EINTR)
         {
-            // 1. 不再检测写事件 -- 修改channel中保存的事件
-            writeEventEnable(conn->channel, false);
-            // 2. 修改dispatcher检测的集合 -- 添加任务节点
-            eventLoopAddTask(conn->evLoop, conn->channel, MODIFY);
-            // 3. 删除这个节点
             eventLoopAddTask(conn->evLoop, conn->channel, DELETE);
+            return 0;
+        }
+        if (result > 0)
+        {
+            outChainConsume(&conn->chain, result);
         }
     }
-    return 0;
+    // 发送数据
+    return tcpConnectionSend(conn);
 }
 
 struct TcpConnection *tcpConnectionInit(int fd, struct EventLoop *evloop)
 {
-    struct TcpConnection *conn = (struct TcpConnection *)malloc(sizeof(struct TcpConnection));
+    struct TcpConnection *conn = (struct TcpConnection *)memPoolAlloc(sizeof(struct TcpConnection));
     conn->evLoop = evloop;
-    conn->readBuf = bufferInit(10240);
+    // 读缓冲区按照请求的大小自动增长(readHint), 一开始不需要太大
+    conn->readBuf = bufferInit(4096);
     conn->writeBuf = bufferInit(10240);
+    outChainInit(&conn->chain);
+    conn->corked = false;
     // http
     conn->request = httpRequestInit();
+    httpRequestSetZeroCopy(conn->request, true); // 解析请求时不拷贝字符串
     conn->response = httpResponseInit();
+    conn->requestNum = 0;
+    conn->keepAlive = false;
+    timerInit(&conn->timer, tcpConnectionTimeout, conn);
+    conn->headerDeadline = false;
+    conn->closing = false;
+    conn->completion = eventLoopCompletionMode(evloop);
+    conn->reading = conn->sending = false;
+    conn->readSize = 0;
+    memset(&conn->msg, 0, sizeof(conn->msg));
+    // 完成模式下不检测读事件, 由接收操作读取数据
+    int events = conn->completion ? ReadEvent | Completion : ReadEvent;
     sprintf(conn->name, "Connection-%d", fd);
-    conn->channel = channelInit(fd, ReadEvent, processRead, processWrite, tcpConnectionDestroy, conn);
-    eventLoopAddTask(evloop, conn->channel, ADD);
+#ifdef EPOLL_ET_MODE
+    // 边沿触发必须使用非阻塞套接字(accept4 得到的已经是非阻塞套接字)
+    conn->channel = channelInit(fd, events | EdgeTrigger, processRead, processWrite, tcpConnectionDestroy, conn);
+#else
+    conn->channel = channelInit(fd, events, processRead, processWrite, tcpConnectionDestroy, conn);
+#endif
+    // 时间轮只能在子线程中访问, 添加 channel 和定时器都交给子线程去做
+    eventLoopRunInLoop(evloop, tcpConnectionStart, conn);
     Debug("和客户端建立连接, threadName: %s, threadID:%s, connName: %s",
           evloop->threadName, evloop->threadID, conn->name);
 
@@ -87,17 +405,18 @@ int tcpConnectionDestroy(void *arg)
     struct TcpConnection *conn = (struct TcpConnection *)arg;
     if (conn != NULL)
     {
-        if (conn->readBuf && bufferReadableSize(conn->readBuf) == 0 &&
-            conn->writeBuf && bufferReadableSize(conn->writeBuf) == 0)
-        {
-            destroyChannel(conn->evLoop, conn->channel);
-            bufferDestroy(conn->readBuf);
-            bufferDestroy(conn->writeBuf);
-            httpRequestDestroy(conn->request);
-            httpResponseDestroy(conn->response);
-            free(conn);
-        }
+        // 长连接断开时读缓冲区中可能还残留着不完整的请求, 不再检查缓冲区是否为空
+        Debug("连接断开, 释放资源, gameover, connName: %s", conn->name);
+        eventLoopCancelTimer(conn->evLoop, &conn->timer);
+        eventLoopUpdateConnNum(conn->evLoop, -1);
+        destroyChannel(conn->evLoop, conn->channel);
+        // 零拷贝模式下请求还引用着读缓冲区, 先释放请求
+        httpRequestDestroy(conn->request);
+        httpResponseDestroy(conn->response);
+        bufferDestroy(conn->readBuf);
+        outChainClear(&conn->chain);
+        bufferDestroy(conn->writeBuf);
+        memPoolFree(conn, sizeof(struct TcpConnection));
     }
-    Debug("连接断开, 释放资源, gameover, connName: %s", conn->name);
     return 0;
 }
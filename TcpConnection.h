@@ -4,19 +4,56 @@
 #include "Channel.h"
 #include "HttpRequest.h"
 #include "HttpResponse.h"
+#include "OutChain.h"
+#include <sys/socket.h>
 
 // #define MSG_SEND_AUTO
+// 边沿触发模式: 读写回调一直处理到 EAGAIN
+// (epoll 使用 EPOLLET, io_uring 使用 multishot poll, poll/select 仍然是水平触发)
+// #define EPOLL_ET_MODE
+
+// 一个长连接最多处理的请求个数, 达到上限之后断开连接
+#define MaxKeepAliveRequests 100
+// 流水线: 读缓冲区中有多个完整的请求时, 最多把这么多个响应合并到写缓冲区中一起发送
+#define MaxPipelineRequests 16
+// 输出链的水位线: 输出链中自己拥有的内存超过这么多之后, 等数据发送出去再继续向响应体索取数据
+#define WriteWatermark 65536
+// 超时时间(ms): 连接空闲(等待下一个请求或者发送数据没有进展)的超时时间, 接收完整请求头的截止时间
+#define IdleTimeout 15000
+#define HeaderTimeout 10000
+// 关闭连接时关闭写端之后继续读取并丢弃客户端数据的最长时间(ms), 避免直接 close 时内核发送 RST
+#define LingerTimeout 2000
+// 读缓冲区中未处理的数据上限: 超过之后仍然不是一个完整的请求就回复 400, 边沿触发时一次最多读取这么多
+#define ReadBufferMax 65536
 
 struct TcpConnection
 {
     struct EventLoop *evLoop;
     struct Channel *channel;
     struct Buffer *readBuf;
-    struct Buffer *writeBuf;
+    struct Buffer *writeBuf; // 生成响应头等数据, 发送之前挂到输出链上
+    struct OutChain chain;   // 等待发送的数据
+    bool corked;             // 是否设置了 TCP_CORK, 当前响应需要多次发送时先攒满报文段, 发送完毕之后再取消
     char name[32];
     // http 协议
     struct HttpRequest *request;
     struct HttpResponse *response;
+    // 长连接: 已经处理的请求个数, 当前响应发送完毕之后是否保持连接
+    int requestNum;
+    bool keepAlive;
+    // 超时检测: 空闲超时或者读取请求头的截止时间, headerDeadline 表示当前请求已经设置了截止时间
+    struct Timer timer;
+    bool headerDeadline;
+    // 响应已经发送完毕, 写端已经关闭, 等待客户端关闭连接
+    bool closing;
+    // 完成模式(io_uring_completion): 接收和发送由内核完成, 完成之后调用读写回调
+    // reading/sending 表示有一个接收/发送操作还没有完成, 完成之前不能修改读缓冲区和输出链头部的数据
+    bool completion;
+    bool reading;
+    bool sending;
+    int readSize;                   // 正在接收的数据最多写入的字节数
+    struct msghdr msg;              // 正在发送的内存段, 发送完成之前保持有效
+    struct iovec vec[ChainMaxIov];
 };
 
 // 初始化
@@ -1,25 +1,56 @@
+#define _GNU_SOURCE
 #include "TcpServer.h"
 #include <arpa/inet.h>
 #include "TcpConnection.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "Log.h"
 
+// 一次转交给某个子线程的一批连接
+struct AcceptBatch
+{
+    struct EventLoop *evLoop;
+    int num;
+    int fds[MaxAcceptBatch];
+};
+
 struct TcpServer *tcpServerInit(unsigned short port, int threadNum)
 {
     struct TcpServer *tcp = (struct TcpServer *)malloc(sizeof(struct TcpServer));
-    tcp->listener = listenerInit(port);
+    tcp->port = port;
+    tcp->backlog = ListenBacklog;
+    tcp->listener = NULL; // 启动服务器时根据监听模式再创建
+    tcp->reusePort = false;
+    tcp->workerListeners = NULL;
     tcp->mainLoop = eventLoopInit();
     tcp->threadNum = threadNum;
     tcp->threadPool = threadPoolInit(tcp->mainLoop, threadNum);
     return tcp;
 }
 
+void tcpServerSetReusePort(struct TcpServer *server, bool reusePort)
+{
+    server->reusePort = reusePort;
+}
+
+void tcpServerSetBacklog(struct TcpServer *server, int backlog)
+{
+    server->backlog = backlog;
+}
+
 struct Listener *listenerInit(unsigned short port)
+{
+    return listenerInitEx(port, false, ListenBacklog);
+}
+
+struct Listener *listenerInitEx(unsigned short port, bool reusePort, int backlog)
 {
     struct Listener *listener = (struct Listener *)malloc(sizeof(struct Listener));
-    // 1. 创建监听的fd
-    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    // 1. 创建监听的fd, 非阻塞, 这样才能一次 accept 多个连接直到 EAGAIN
+    int lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (lfd == -1)
     {
         perror("socket");
@@ -33,6 +64,16 @@ struct Listener *listenerInit(unsigned short port)
         perror("setsockopt");
         return NULL;
     }
+    // 多个监听套接字绑定同一个端口, 由内核在它们之间分配新连接
+    if (reusePort)
+    {
+        ret = setsockopt(lfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof opt);
+        if (ret == -1)
+        {
+            perror("setsockopt");
+            return NULL;
+        }
+    }
     // 3. 绑定
     struct sockaddr_in addr;
     addr.sin_family = AF_INET;
@@ -45,7 +86,7 @@ struct Listener *listenerInit(unsigned short port)
         return NULL;
     }
     // 4. 设置监听
-    ret = listen(lfd, 128);
+    ret = listen(lfd, backlog);
     if (ret == -1)
     {
         perror("listen");
@@ -54,31 +95,191 @@ struct Listener *listenerInit(unsigned short port)
     // 返回fd
     listener->lfd = lfd;
     listener->port = port;
+    listener->evLoop = NULL;
+    listener->idleFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    listener->channel = NULL;
     return listener;
 }
 
+// 文件描述符耗尽: 释放预留的 fd, 接收连接之后马上关闭, 让客户端尽快得到响应,
+// 否则连接一直留在监听队列中, 水平触发模式下监听套接字会一直可读造成忙循环
+static void listenerReject(struct Listener *listener)
+{
+    Debug("文件描述符耗尽, 拒绝新连接");
+    close(listener->idleFd);
+    int cfd = accept(listener->lfd, NULL, NULL);
+    if (cfd >= 0)
+    {
+        close(cfd);
+    }
+    listener->idleFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+// 非阻塞地接收一批连接, 直到 EAGAIN 或者达到上限, 返回接收到的连接个数
+static int listenerAccept(struct Listener *listener, int *fds, int max)
+{
+    int num = 0;
+    if (listener->channel->events & Completion)
+    {
+        // 完成模式: 内核已经接收了一个连接, 结果是新连接的 fd 或者 -errno
+        int result = listener->channel->result;
+        if (result >= 0)
+        {
+            fds[num++] = result;
+        }
+        else if ((result == -EMFILE || result == -ENFILE) && listener->idleFd != -1)
+        {
+            listenerReject(listener);
+        }
+        return num;
+    }
+    for (int i = 0; i < max; ++i)
+    {
+        // 直接得到非阻塞的通信套接字, 不需要再调用 fcntl
+        int cfd = accept4(listener->lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd >= 0)
+        {
+            fds[num++] = cfd;
+        }
+        else if (errno == EINTR || errno == ECONNABORTED)
+        {
+            continue;
+        }
+        else if ((errno == EMFILE || errno == ENFILE) && listener->idleFd != -1)
+        {
+            listenerReject(listener);
+        }
+        else
+        {
+            break; // EAGAIN: 监听队列中已经没有连接了
+        }
+    }
+    return num;
+}
+
+// 把监听套接字添加到事件循环中, 在事件循环的线程中调用
+// 完成模式下提交 multishot accept, 之后每接收一个连接调用一次读回调
+static int listenerStart(void *arg)
+{
+    struct Listener *listener = (struct Listener *)arg;
+    struct EventLoop *evLoop = listener->evLoop;
+    eventLoopAdd(evLoop, listener->channel);
+    if (listener->channel->events & Completion)
+    {
+        eventLoopAccept(evLoop, listener->channel);
+    }
+    return 0;
+}
+
+// 在子线程中处理主线程转交过来的一批连接
+static int acceptBatchRun(void *arg)
+{
+    struct AcceptBatch *batch = (struct AcceptBatch *)arg;
+    for (int i = 0; i < batch->num; ++i)
+    {
+        tcpConnectionInit(batch->fds[i], batch->evLoop);
+    }
+    free(batch);
+    return 0;
+}
+
 int acceptConnection(void *arg)
 {
     struct TcpServer *server = (struct TcpServer *)arg;
     // 和客户端建立连接
-    int cfd = accept(server->listener->lfd, NULL, NULL);
-    // 从线程池中取出一个子线程的反应堆实例, 去处理这个cfd
-    struct EventLoop *evLoop = takeWorkerEventLoop(server->threadPool);
-    // 将cfd放到 TcpConnection中处理
-    tcpConnectionInit(cfd, evLoop);
+    int fds[MaxAcceptBatch];
+    int num = listenerAccept(server->listener, fds, MaxAcceptBatch);
+    // 按照子线程分组, 每个子线程只转交一次(加一次锁, 唤醒一次)
+    struct AcceptBatch *batches[MaxAcceptBatch];
+    int batchNum = 0;
+    for (int i = 0; i < num; ++i)
+    {
+        // 从线程池中取出一个子线程的反应堆实例, 去处理这个cfd
+        struct EventLoop *evLoop = takeWorkerEventLoop(server->threadPool);
+        // 马上计入子线程的连接数, 同一批中后面的连接选择子线程时就能看到
+        eventLoopUpdateConnNum(evLoop, 1);
+        int j = 0;
+        while (j < batchNum && batches[j]->evLoop != evLoop)
+        {
+            ++j;
+        }
+        if (j == batchNum)
+        {
+            batches[batchNum] = (struct AcceptBatch *)malloc(sizeof(struct AcceptBatch));
+            batches[batchNum]->evLoop = evLoop;
+            batches[batchNum]->num = 0;
+            batchNum++;
+        }
+        batches[j]->fds[batches[j]->num++] = fds[i];
+    }
+    // 将cfd放到 TcpConnection中处理, TcpConnection 在子线程中创建
+    for (int i = 0; i < batchNum; ++i)
+    {
+        eventLoopRunInLoop(batches[i]->evLoop, acceptBatchRun, batches[i]);
+    }
     return 0;
 }
 
+// SO_REUSEPORT 模式下子线程的监听套接字的读事件处理函数, 在子线程中 accept 并处理连接
+int acceptConnectionLocal(void *arg)
+{
+    struct Listener *listener = (struct Listener *)arg;
+    int fds[MaxAcceptBatch];
+    int num = listenerAccept(listener, fds, MaxAcceptBatch);
+    for (int i = 0; i < num; ++i)
+    {
+        // 连接就在当前线程中处理, 不需要跨线程转交
+        eventLoopUpdateConnNum(listener->evLoop, 1);
+        tcpConnectionInit(fds[i], listener->evLoop);
+    }
+    return 0;
+}
+
+// 监听套接字检测的事件: 完成模式下由 accept 操作接收连接, 不检测读事件
+static int listenerEvents(struct EventLoop *evLoop)
+{
+    return eventLoopCompletionMode(evLoop) ? ReadEvent | Completion : ReadEvent;
+}
+
 void tcpServerRun(struct TcpServer *server)
 {
     Debug("服务器程序已经启动了...");
     // 启动线程池
     threadPoolRun(server->threadPool);
+    if (server->reusePort && server->threadNum > 0)
+    {
+        // 每个子线程创建自己的监听套接字, 添加到子线程的反应堆中
+        server->workerListeners = (struct Listener *)malloc(sizeof(struct Listener) * server->threadNum);
+        for (int i = 0; i < server->threadNum; ++i)
+        {
+            struct Listener *listener = listenerInitEx(server->port, true, server->backlog);
+            if (listener == NULL)
+            {
+                exit(0);
+            }
+            server->workerListeners[i] = *listener;
+            free(listener);
+            struct EventLoop *evLoop = server->threadPool->workerThreads[i].evLoop;
+            server->workerListeners[i].evLoop = evLoop;
+            server->workerListeners[i].channel = channelInit(server->workerListeners[i].lfd, listenerEvents(evLoop),
+                                                             acceptConnectionLocal, NULL, NULL, &server->workerListeners[i]);
+            eventLoopRunInLoop(evLoop, listenerStart, &server->workerListeners[i]);
+        }
+        // 主线程不再处理新连接
+        eventLoopRun(server->mainLoop);
+        return;
+    }
+    server->listener = listenerInitEx(server->port, false, server->backlog);
+    if (server->listener == NULL)
+    {
+        exit(0);
+    }
     // 添加检测的任务
     // 初始化一个channel实例
-    struct Channel *channel = channelInit(server->listener->lfd,
-                                          ReadEvent, acceptConnection, NULL, NULL, server);
-    eventLoopAddTask(server->mainLoop, channel, ADD);
+    server->listener->evLoop = server->mainLoop;
+    server->listener->channel = channelInit(server->listener->lfd, listenerEvents(server->mainLoop),
+                                            acceptConnection, NULL, NULL, server);
+    listenerStart(server->listener);
     // 启动反应堆模型
     eventLoopRun(server->mainLoop);
 }
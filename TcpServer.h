@@ -2,23 +2,44 @@
 #include "EventLoop.h"
 #include "ThreadPool.h"
 
+// 默认的监听队列长度
+#define ListenBacklog 128
+// 每次监听套接字可读时最多 accept 的连接个数, 避免长时间停留在 accept 上
+#define MaxAcceptBatch 64
+
 struct Listener
 {
     int lfd;
     unsigned short port;
+    // 监听套接字所属的反应堆, SO_REUSEPORT 模式下是子线程的反应堆, 建立的连接直接在这个线程中处理
+    struct EventLoop *evLoop;
+    // 预留的文件描述符, 文件描述符耗尽(EMFILE)时释放它来接收并关闭新连接
+    int idleFd;
+    // 监听套接字的 channel, 完成模式下 accept 的结果保存在其中
+    struct Channel *channel;
 };
 
 struct TcpServer
 {
     int threadNum;
+    unsigned short port;
+    int backlog;
     struct EventLoop *mainLoop;
     struct ThreadPool *threadPool;
     struct Listener *listener;
+    // SO_REUSEPORT 模式: 每个子线程有自己的监听套接字, 由内核分配连接, 不再由主线程 accept 之后转交
+    bool reusePort;
+    struct Listener *workerListeners;
 };
 
 // 初始化
 struct TcpServer *tcpServerInit(unsigned short port, int threadNum);
+// 设置 SO_REUSEPORT 模式, 需要在启动服务器之前设置
+void tcpServerSetReusePort(struct TcpServer *server, bool reusePort);
+// 设置监听队列的长度, 需要在启动服务器之前设置
+void tcpServerSetBacklog(struct TcpServer *server, int backlog);
 // 初始化监听
 struct Listener *listenerInit(unsigned short port);
+struct Listener *listenerInitEx(unsigned short port, bool reusePort, int backlog);
 // 启动服务器
 void tcpServerRun(struct TcpServer *server);
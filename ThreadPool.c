@@ -1,6 +1,8 @@
 #include "ThreadPool.h" // 包含 ThreadPool 头文件
 #include <assert.h>     // 包含断言头文件，用于条件检查
 #include <stdlib.h>     // 包含标准库函数，如 malloc, free
+#include <string.h>     // 包含 strcmp
+#include <time.h>       // 包含 time, 用于初始化随机数种子
 
 // 初始化线程池
 struct ThreadPool *threadPoolInit(struct EventLoop *mainLoop, int count)
@@ -11,11 +13,100 @@ struct ThreadPool *threadPoolInit(struct EventLoop *mainLoop, int count)
     pool->isStart = false;     // 初始化线程池启动标志为 false
     pool->mainLoop = mainLoop; // 设置主事件循环
     pool->threadNum = count;   // 设置线程数量
+    pool->balance = balanceRoundRobin;        // 默认轮询
+    pool->seed = (unsigned int)time(NULL);    // 初始化随机数种子
     // 分配 WorkerThread 数组的内存
     pool->workerThreads = (struct WorkerThread *)malloc(sizeof(struct WorkerThread) * count);
     return pool; // 返回线程池指针
 }
 
+// 轮询
+int balanceRoundRobin(struct ThreadPool *pool)
+{
+    int index = pool->index;
+    pool->index = (index + 1) % pool->threadNum; // 更新索引，轮询选择，雨露均沾
+    return index;
+}
+
+// 子线程的负载: 连接数加上还没有处理的任务数
+static int workerLoad(struct EventLoop *evLoop)
+{
+    return __atomic_load_n(&evLoop->connNum, __ATOMIC_RELAXED) +
+           __atomic_load_n(&evLoop->taskNum, __ATOMIC_RELAXED);
+}
+
+// 比较两个子线程的负载, 负载相同的时候比较最近的繁忙程度, a 的负载更小返回 true
+static bool workerLess(struct EventLoop *a, struct EventLoop *b)
+{
+    int loadA = workerLoad(a);
+    int loadB = workerLoad(b);
+    if (loadA != loadB)
+    {
+        return loadA < loadB;
+    }
+    return __atomic_load_n(&a->busyTime, __ATOMIC_RELAXED) < __atomic_load_n(&b->busyTime, __ATOMIC_RELAXED);
+}
+
+// 选择负载最小的子线程, 从上次的位置开始找, 负载都相同时退化为轮询
+int balanceLeastConnections(struct ThreadPool *pool)
+{
+    int best = pool->index;
+    for (int i = 1; i < pool->threadNum; ++i)
+    {
+        int index = (pool->index + i) % pool->threadNum;
+        if (workerLess(pool->workerThreads[index].evLoop, pool->workerThreads[best].evLoop))
+        {
+            best = index;
+        }
+    }
+    pool->index = (best + 1) % pool->threadNum;
+    return best;
+}
+
+// 随机选两个不同的子线程, 取负载小的那个, 不需要遍历所有的子线程
+int balancePowerOfTwoChoices(struct ThreadPool *pool)
+{
+    if (pool->threadNum == 1)
+    {
+        return 0;
+    }
+    int a = rand_r(&pool->seed) % pool->threadNum;
+    int b = rand_r(&pool->seed) % (pool->threadNum - 1);
+    if (b >= a)
+    {
+        b++;
+    }
+    return workerLess(pool->workerThreads[b].evLoop, pool->workerThreads[a].evLoop) ? b : a;
+}
+
+// 设置负载均衡策略
+void threadPoolSetBalance(struct ThreadPool *pool, balanceFunc balance)
+{
+    pool->balance = balance;
+}
+
+// 通过名字选择负载均衡策略
+bool threadPoolSelectBalance(struct ThreadPool *pool, const char *name)
+{
+    if (strcmp(name, "round_robin") == 0)
+    {
+        pool->balance = balanceRoundRobin;
+    }
+    else if (strcmp(name, "least_conn") == 0)
+    {
+        pool->balance = balanceLeastConnections;
+    }
+    else if (strcmp(name, "p2c") == 0)
+    {
+        pool->balance = balancePowerOfTwoChoices;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
 // 启动线程池，必须是主线程启动线程池
 void threadPoolRun(struct ThreadPool *pool)
 {
@@ -48,9 +139,8 @@ struct EventLoop *takeWorkerEventLoop(struct ThreadPool *pool)
     struct EventLoop *evLoop = pool->mainLoop; // 默认使用主事件循环
     if (pool->threadNum > 0)
     {
-        // 轮询选择一个工作线程的事件循环
-        evLoop = pool->workerThreads[pool->index].evLoop;
-        pool->index = ++pool->index % pool->threadNum; // 更新索引，轮询选择，雨露均沾
+        // 按照负载均衡策略选择一个工作线程的事件循环
+        evLoop = pool->workerThreads[pool->balance(pool)].evLoop;
     }
     return evLoop; // 返回选中的事件循环实例
 }
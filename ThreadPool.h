@@ -3,6 +3,10 @@
 #include <stdbool.h>
 #include "WorkerThread.h"
 
+struct ThreadPool;
+// 负载均衡策略: 返回处理新连接的子线程的下标
+typedef int (*balanceFunc)(struct ThreadPool *pool);
+
 // 定义线程池
 struct ThreadPool
 {
@@ -13,10 +17,22 @@ struct ThreadPool
     int threadNum;
     struct WorkerThread *workerThreads;
     int index;
+    // 选择子线程的策略, 默认轮询
+    balanceFunc balance;
+    unsigned int seed; // 随机选择子线程时使用的随机数种子
 };
 
+// 内置的负载均衡策略
+int balanceRoundRobin(struct ThreadPool *pool);        // 轮询
+int balanceLeastConnections(struct ThreadPool *pool);  // 选择负载最小的子线程
+int balancePowerOfTwoChoices(struct ThreadPool *pool); // 随机选两个子线程, 取负载小的那个
+
 // 初始化线程池
 struct ThreadPool *threadPoolInit(struct EventLoop *mainLoop, int count);
+// 设置负载均衡策略, 需要在启动服务器之前设置
+void threadPoolSetBalance(struct ThreadPool *pool, balanceFunc balance);
+// 通过名字选择负载均衡策略: "round_robin", "least_conn", "p2c", 返回是否找到了这个策略
+bool threadPoolSelectBalance(struct ThreadPool *pool, const char *name);
 // 启动线程池
 void threadPoolRun(struct ThreadPool *pool);
 // 取出线程池中的某个子线程的反应堆实例
@@ -0,0 +1,208 @@
+#include "TimerWheel.h"
+#include <stdlib.h>
+#include <time.h>
+
+#define WheelMask (WheelSlots - 1)
+// 时间轮能够表示的最大时间差, 超过这个值的定时器先放到最高层, 级联的时候再重新计算
+#define WheelRange (1ULL << (WheelBits * WheelLevels))
+
+static void listInit(struct Timer *head)
+{
+    head->prev = head->next = head;
+}
+
+static bool listEmpty(struct Timer *head)
+{
+    return head->next == head;
+}
+
+static void listAppend(struct Timer *head, struct Timer *timer)
+{
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+static void listRemove(struct Timer *timer)
+{
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = timer->next = NULL;
+}
+
+uint64_t timerWheelNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+struct TimerWheel *timerWheelInit()
+{
+    struct TimerWheel *wheel = (struct TimerWheel *)malloc(sizeof(struct TimerWheel));
+    wheel->current = timerWheelNow();
+    wheel->count = 0;
+    for (int i = 0; i < WheelLevels; ++i)
+    {
+        for (int j = 0; j < WheelSlots; ++j)
+        {
+            listInit(&wheel->slots[i][j]);
+        }
+    }
+    return wheel;
+}
+
+void timerWheelDestroy(struct TimerWheel *wheel)
+{
+    if (wheel == NULL)
+    {
+        return;
+    }
+    // 定时器节点的内存由使用者管理, 这里只把它们从链表中摘下来
+    for (int i = 0; i < WheelLevels; ++i)
+    {
+        for (int j = 0; j < WheelSlots; ++j)
+        {
+            struct Timer *head = &wheel->slots[i][j];
+            while (!listEmpty(head))
+            {
+                listRemove(head->next);
+            }
+        }
+    }
+    free(wheel);
+}
+
+void timerInit(struct Timer *timer, handleFunc callback, void *arg)
+{
+    timer->expire = 0;
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->prev = timer->next = NULL;
+}
+
+bool timerPending(struct Timer *timer)
+{
+    return timer->prev != NULL;
+}
+
+// 根据到期时间和当前时间的差值, 把定时器挂到对应层的槽中
+static void timerWheelPlace(struct TimerWheel *wheel, struct Timer *timer)
+{
+    uint64_t expire = timer->expire;
+    uint64_t diff = expire - wheel->current;
+    if (diff >= WheelRange)
+    {
+        expire = wheel->current + WheelRange - 1;
+        diff = WheelRange - 1;
+    }
+    // 找到能容纳这个时间差的最低的一层
+    int level = 0;
+    while (level < WheelLevels - 1 && diff >= (1ULL << (WheelBits * (level + 1))))
+    {
+        level++;
+    }
+    int slot = (expire >> (WheelBits * level)) & WheelMask;
+    listAppend(&wheel->slots[level][slot], timer);
+}
+
+void timerWheelAdd(struct TimerWheel *wheel, struct Timer *timer, int timeout)
+{
+    if (timerPending(timer))
+    {
+        timerWheelCancel(wheel, timer);
+    }
+    timer->expire = timerWheelNow() + (timeout > 0 ? timeout : 0);
+    if (timer->expire <= wheel->current)
+    {
+        // 已经处理过的时间点, 放到下一个时间点处理
+        timer->expire = wheel->current + 1;
+    }
+    timerWheelPlace(wheel, timer);
+    wheel->count++;
+}
+
+void timerWheelCancel(struct TimerWheel *wheel, struct Timer *timer)
+{
+    if (timerPending(timer))
+    {
+        listRemove(timer);
+        wheel->count--;
+    }
+}
+
+// 级联: 把上层某个槽中的定时器重新分配到下面的层中
+static void timerWheelCascade(struct TimerWheel *wheel, int level, int slot)
+{
+    struct Timer *head = &wheel->slots[level][slot];
+    while (!listEmpty(head))
+    {
+        struct Timer *timer = head->next;
+        listRemove(timer);
+        timerWheelPlace(wheel, timer);
+    }
+}
+
+void timerWheelExpire(struct TimerWheel *wheel)
+{
+    uint64_t now = timerWheelNow();
+    while (wheel->current < now)
+    {
+        if (wheel->count == 0)
+        {
+            // 时间轮是空的, 直接跳到当前时间
+            wheel->current = now;
+            break;
+        }
+        uint64_t t = ++wheel->current;
+        // 低层转完一圈, 从高层到低层依次级联
+        int level = 0;
+        while (level < WheelLevels - 1 && (t & ((1ULL << (WheelBits * (level + 1))) - 1)) == 0)
+        {
+            level++;
+        }
+        for (; level > 0; --level)
+        {
+            timerWheelCascade(wheel, level, (t >> (WheelBits * level)) & WheelMask);
+        }
+        // 处理第 0 层当前槽中到期的定时器, 回调函数中可以添加或者取消其他定时器
+        struct Timer *head = &wheel->slots[0][t & WheelMask];
+        while (!listEmpty(head))
+        {
+            struct Timer *timer = head->next;
+            listRemove(timer);
+            wheel->count--;
+            timer->callback(timer->arg);
+        }
+    }
+}
+
+int timerWheelNextTimeout(struct TimerWheel *wheel)
+{
+    if (wheel->count == 0)
+    {
+        return -1;
+    }
+    // 每一层找到第一个非空的槽, 第 0 层是定时器到期的时间, 上层是需要级联的时间, 取最小值
+    uint64_t next = 0;
+    for (int level = 0; level < WheelLevels; ++level)
+    {
+        int shift = WheelBits * level;
+        uint64_t index = wheel->current >> shift;
+        for (int i = 1; i <= WheelSlots; ++i)
+        {
+            if (!listEmpty(&wheel->slots[level][(index + i) & WheelMask]))
+            {
+                uint64_t t = (index + i) << shift;
+                if (next == 0 || t < next)
+                {
+                    next = t;
+                }
+                break;
+            }
+        }
+    }
+    uint64_t now = timerWheelNow();
+    return next > now ? (int)(next - now) : 0;
+}
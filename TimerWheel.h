@@ -0,0 +1,46 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "Channel.h"
+
+// 时间轮的层数和每一层的槽数: 第 0 层每个槽 1ms, 上一层的一个槽等于下一层转一圈
+#define WheelLevels 4
+#define WheelBits 6
+#define WheelSlots (1 << WheelBits)
+
+// 定时器节点, 由使用者分配(例如嵌入到 TcpConnection 中), 时间轮只负责把它挂到链表上
+struct Timer
+{
+    uint64_t expire;      // 到期时间, 单位: ms
+    handleFunc callback;  // 到期之后调用的函数
+    void *arg;            // 回调函数的参数
+    struct Timer *prev;   // 双向链表, 取消定时器的时间复杂度为 O(1)
+    struct Timer *next;
+};
+
+// 分层时间轮, 只能在所属的事件循环线程中使用
+struct TimerWheel
+{
+    uint64_t current;                                // 已经处理到的时间, 单位: ms
+    int count;                                       // 时间轮中定时器的个数
+    struct Timer slots[WheelLevels][WheelSlots];     // 每个槽都是一个带头节点的双向循环链表
+};
+
+// 得到单调时钟的当前时间, 单位: ms
+uint64_t timerWheelNow();
+// 初始化
+struct TimerWheel *timerWheelInit();
+// 销毁(不会调用还没有到期的定时器)
+void timerWheelDestroy(struct TimerWheel *wheel);
+// 初始化定时器节点
+void timerInit(struct Timer *timer, handleFunc callback, void *arg);
+// 定时器是否在时间轮中等待到期
+bool timerPending(struct Timer *timer);
+// 添加定时器, timeout 毫秒之后到期, 如果定时器已经在时间轮中则重新设置到期时间
+void timerWheelAdd(struct TimerWheel *wheel, struct Timer *timer, int timeout);
+// 取消定时器
+void timerWheelCancel(struct TimerWheel *wheel, struct Timer *timer);
+// 处理到期的定时器
+void timerWheelExpire(struct TimerWheel *wheel);
+// 距离下一次需要处理定时器还有多少毫秒, 时间轮为空返回 -1
+int timerWheelNextTimeout(struct TimerWheel *wheel);
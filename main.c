@@ -1,11 +1,14 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include "TcpServer.h"
+#include "FileCache.h"
+#include "MimeType.h"
 /*
 路径：/home/kobe/linux/dabing/luffy
 
-gcc main.c Buffer.c Channel.c ChannelMap.c EpollDispatcher.c EventLoop.c HttpRequest.c Httpresponse.c TcpConnection.c TcpServer.c ThreadPool.c WorkerThread.c SelectDispatcher.c PollDispatcher.c -lpthread
+gcc main.c Buffer.c Channel.c ChannelMap.c EpollDispatcher.c EventLoop.c HttpRequest.c Httpresponse.c TcpConnection.c TcpServer.c ThreadPool.c WorkerThread.c SelectDispatcher.c PollDispatcher.c IoUringDispatcher.c TimerWheel.c DelimIndex.c FileCache.c MemPool.c OutChain.c MimeType.c -lpthread
 
 ./a.out
 
@@ -27,8 +30,43 @@ int main(int argc, char *argv[])
     unsigned short port = 10000;
     chdir("/home/kobe/linux/dabing/luffy");
 #endif
+    // 选择 IO 多路复用模型: epoll, poll, select, io_uring, io_uring_completion(接收/发送/accept 由 io_uring 完成)
+    const char *dispatcher = getenv("REACTOR_DISPATCHER");
+    if (dispatcher != NULL)
+    {
+        eventLoopSelectDispatcher(dispatcher);
+    }
     // 启动服务器
     struct TcpServer *server = tcpServerInit(port, 4);
+    // 每个子线程使用自己的 SO_REUSEPORT 监听套接字
+    const char *reusePort = getenv("REACTOR_REUSEPORT");
+    tcpServerSetReusePort(server, reusePort != NULL && strcmp(reusePort, "1") == 0);
+    // 监听队列的长度
+    const char *backlog = getenv("REACTOR_BACKLOG");
+    if (backlog != NULL)
+    {
+        tcpServerSetBacklog(server, atoi(backlog));
+    }
+    // 选择子线程的负载均衡策略: round_robin, least_conn, p2c
+    const char *balance = getenv("REACTOR_BALANCE");
+    if (balance != NULL)
+    {
+        threadPoolSelectBalance(server->threadPool, balance);
+    }
+    // 热点文件缓存: 每个线程使用的内存上限和单个文件的大小上限(字节)
+    const char *hotCache = getenv("REACTOR_HOT_CACHE");
+    const char *hotFileMax = getenv("REACTOR_HOT_FILE_MAX");
+    if (hotCache != NULL || hotFileMax != NULL)
+    {
+        fileCacheSetHotLimit(hotCache != NULL ? atol(hotCache) : HotCacheBudget,
+                             hotFileMax != NULL ? atoi(hotFileMax) : HotFileMaxSize);
+    }
+    // 文件类型: 加载 mime.types 格式的文件, 覆盖内置的类型
+    const char *mimeTypes = getenv("REACTOR_MIME_TYPES");
+    if (mimeTypes != NULL && mimeTypeLoad(mimeTypes) == -1)
+    {
+        perror("mime.types");
+    }
     tcpServerRun(server);
 
     return 0;